@@ -0,0 +1,15 @@
+#include "_syscalls_impl.h"
+
+int high_byte(int a, int b);
+
+// Only reached through this pointer: whether high_byte is a function
+// start is up to the liveness check of its first instruction.
+int (*volatile op)(int, int) = high_byte;
+
+int main() {
+    return op(0, 0x2f00);
+}
+
+void ENTRYPOINT _start() {
+    _exit(main());
+}
@@ -0,0 +1,47 @@
+#include "_syscalls_impl.h"
+
+int g;
+
+__attribute__((noinline)) int sw(int x, int y) {
+    switch (x) {
+    case 0: g = y + 1; break;
+    case 1: g = y * 3; /* fall through */
+    case 2: g += 7; break;
+    case 3: g = y - 5; break;
+    case 4: return y ^ 9;
+    case 5: g = 11; break;
+    case 6: g = y << 2; break;
+    case 8: g = y / 3; break;
+    default: g = 0;
+    }
+    return g;
+}
+
+__attribute__((noinline)) static int sw2(int x, int a, int b, int c) {
+    int r = 0;
+    for (int i = 0; i < x; ++i) {
+        switch ((i * a) % 9) {
+        case 0: r += b; break;
+        case 1: r ^= c; break;
+        case 2: r -= a; break;
+        case 3: r *= 3; break;
+        case 5: r += c * b; break;
+        case 6: r >>= 1; break;
+        case 7: r |= b; break;
+        case 8: r = r * r; break;
+        }
+    }
+    return r;
+}
+
+int main() {
+    int s = 0;
+    for (int i = 0; i < 10; ++i)
+        s += sw(i, s);
+    s += sw2(s & 15, 3, 5, 7);
+    _putc(1, 'a' + (s & 15));
+    return s & 1;
+}
+void ENTRYPOINT _start() {
+    _exit(main());
+}
@@ -0,0 +1,42 @@
+#include "_syscalls_impl.h"
+
+typedef struct { int quot, rem; } div_t;
+
+div_t div(int a, int b) { div_t r = {a / b, a % b}; return r; }
+int abs(int a) { return a < 0 ? -a : a; }
+
+char* utoa(unsigned v, char* buf, int base) {
+    char tmp[33];
+    int n = 0;
+    do { tmp[n++] = "0123456789abcdef"[v % base]; v /= base; } while (v);
+    char* p = buf;
+    while (n) *p++ = tmp[--n];
+    *p = 0;
+    return buf;
+}
+
+char* itoa(int v, char* buf, int base) {
+    if (v < 0) { buf[0] = '-'; utoa(-v, buf + 1, base); return buf; }
+    return utoa(v, buf, base);
+}
+
+int puts(const char* s) {
+    while (*s)
+        _putc(1, *s++);
+    _putc(1, '\n');
+    return 0;
+}
+
+extern void french_tail_callback(int (*func) (const char*));
+extern char* (*func_jumptable[])(int, char*, int);
+
+int main() {
+    french_tail_callback(puts);
+    char local_buf[32];
+    puts(func_jumptable[2](-123, local_buf, 10));
+    return 47;
+}
+
+void ENTRYPOINT _start() {
+    _exit(main());
+}
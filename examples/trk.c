@@ -0,0 +1,17 @@
+#include "_syscalls_impl.h"
+
+void french_tail_callback(void (*f)(const char*));
+
+static void show(const char* s) {
+    while (*s)
+        _putc(1, *s++);
+}
+
+int main() {
+    french_tail_callback(show);
+    return 0;
+}
+
+void ENTRYPOINT _start() {
+    _exit(main());
+}
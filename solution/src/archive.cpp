@@ -0,0 +1,78 @@
+#include "archive.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "error.h"
+
+namespace symbolize {
+
+namespace {
+
+constexpr char kMagic[] = "!<arch>\n";
+constexpr size_t kMagicSize = 8;
+constexpr size_t kHeaderSize = 60;
+
+// ar_hdr fields are space-padded ASCII.
+std::string field(const uint8_t* p, size_t size)
+{
+    std::string s(reinterpret_cast<const char*>(p), size);
+    s.erase(s.find_last_not_of(' ') + 1);
+    return s;
+}
+
+} // namespace
+
+std::vector<ArchiveMember> read_archive(const MappedFile& file, const std::string& path)
+{
+    const uint8_t* data = file.data();
+    const size_t size = file.size();
+    if (size < kMagicSize || std::memcmp(data, kMagic, kMagicSize) != 0)
+        throw Error(path + ": not an ar archive");
+
+    std::vector<ArchiveMember> members;
+    Span<uint8_t> long_names;
+    size_t pos = kMagicSize;
+    while (pos + kHeaderSize <= size) {
+        const uint8_t* header = data + pos;
+        if (header[58] != '`' || header[59] != '\n')
+            throw Error(path + ": malformed member header");
+        const std::string name = field(header, 16);
+        const std::string size_field = field(header + 48, 10);
+        char* end = nullptr;
+        const unsigned long member_size = std::strtoul(size_field.c_str(), &end, 10);
+        pos += kHeaderSize;
+        if (size_field.empty() || *end || member_size > size - pos)
+            throw Error(path + ": member " + name + " runs past the end");
+        const Span<uint8_t> body(data + pos, member_size);
+        pos += member_size + (member_size & 1);
+
+        if (name == "/" || name == "/SYM64/" || name == "__.SYMDEF")
+            continue;
+        if (name == "//") {
+            long_names = body;
+            continue;
+        }
+        ArchiveMember member;
+        member.data = body;
+        if (name.size() > 1 && name[0] == '/') {
+            // GNU long name: "/<offset>" into the "//" member, ended by "/\n".
+            const unsigned long offset = std::strtoul(name.c_str() + 1, nullptr, 10);
+            if (offset >= long_names.size())
+                throw Error(path + ": bad long member name " + name);
+            const char* begin = reinterpret_cast<const char*>(long_names.data()) + offset;
+            const char* stop = begin;
+            while (stop < reinterpret_cast<const char*>(long_names.end()) && *stop != '\n')
+                ++stop;
+            member.name.assign(begin, stop);
+        } else {
+            member.name = name;
+        }
+        if (!member.name.empty() && member.name.back() == '/')
+            member.name.pop_back();
+        members.push_back(std::move(member));
+    }
+    return members;
+}
+
+} // namespace symbolize
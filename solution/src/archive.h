@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "span.h"
+
+namespace symbolize {
+
+// A member of a static library, pointing into the mapped archive.
+struct ArchiveMember {
+    std::string name;
+    Span<uint8_t> data;
+};
+
+// The object members of a System V/GNU `ar` archive (the symbol index and
+// the long name table are skipped). Throws Error on a malformed archive.
+std::vector<ArchiveMember> read_archive(const MappedFile& file, const std::string& path);
+
+} // namespace symbolize
@@ -0,0 +1,54 @@
+#include "arena.h"
+
+#include <algorithm>
+
+namespace symbolize {
+
+void* Arena::allocate(size_t bytes, size_t align)
+{
+    if (!blocks_.empty()) {
+        Block& block = blocks_.back();
+        const size_t begin = (offset_ + align - 1) & ~(align - 1);
+        if (begin + bytes <= block.size) {
+            used_ += begin + bytes - offset_;
+            offset_ = begin + bytes;
+            peak_ = std::max(peak_, used_);
+            return block.data.get() + begin;
+        }
+    }
+    // new[] memory is aligned for any fundamental type.
+    Block block;
+    block.size = std::max(block_size_, bytes);
+    block.data.reset(new unsigned char[block.size]);
+    blocks_.push_back(std::move(block));
+    offset_ = bytes;
+    used_ += bytes;
+    peak_ = std::max(peak_, used_);
+    return blocks_.back().data.get();
+}
+
+void Arena::reset()
+{
+    // Several blocks mean the last input outgrew the arena: replace them with
+    // one block that holds what it needed.
+    if (blocks_.size() > 1) {
+        blocks_.clear();
+        block_size_ = std::max(block_size_, peak_);
+        Block block;
+        block.size = block_size_;
+        block.data.reset(new unsigned char[block.size]);
+        blocks_.push_back(std::move(block));
+    }
+    offset_ = 0;
+    used_ = 0;
+}
+
+size_t Arena::capacity() const
+{
+    size_t total = 0;
+    for (const Block& block : blocks_)
+        total += block.size;
+    return total;
+}
+
+} // namespace symbolize
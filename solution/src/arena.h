@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace symbolize {
+
+// A bump allocator for the scratch arrays of one input. Nothing is freed
+// until reset(), which releases everything at once and keeps a single block
+// as large as the peak use: an arena reused for a series of inputs stops
+// calling malloc after the first few. Not thread-safe.
+class Arena {
+public:
+    explicit Arena(size_t block_size = kDefaultBlock) : block_size_(block_size) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t bytes, size_t align);
+
+    template <typename T>
+    T* allocate(size_t n)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destroyed");
+        return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void reset();
+
+    size_t used() const { return used_; }
+    size_t capacity() const;
+
+private:
+    static constexpr size_t kDefaultBlock = 1 << 20;
+
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size = 0;
+    };
+
+    std::vector<Block> blocks_;
+    size_t offset_ = 0; // into blocks_.back()
+    size_t used_ = 0;
+    size_t peak_ = 0;
+    size_t block_size_;
+};
+
+// Standard allocator over an Arena, for containers living no longer than the
+// arena's current use. deallocate() is a no-op.
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena& arena) : arena_(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena())
+    {
+    }
+
+    T* allocate(size_t n) { return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    Arena* arena() const { return arena_; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena_ == other.arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena_ != other.arena(); }
+
+private:
+    Arena* arena_;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+} // namespace symbolize
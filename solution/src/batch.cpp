@@ -0,0 +1,78 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "error.h"
+
+namespace symbolize {
+
+std::vector<BatchJob> read_manifest(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in)
+        throw Error("cannot open " + path);
+
+    std::vector<BatchJob> jobs;
+    std::string line;
+    for (size_t number = 1; std::getline(in, line); ++number) {
+        std::istringstream fields(line);
+        BatchJob job;
+        std::string extra;
+        if (!(fields >> job.input) || job.input[0] == '#')
+            continue;
+        if (!(fields >> job.output) || fields >> extra)
+            throw Error(path + ":" + std::to_string(number) + ": expected `in out`");
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+size_t run_batch(const std::vector<BatchJob>& jobs, unsigned workers, const FileOptions& base)
+{
+    workers = unsigned(std::max<size_t>(1, std::min<size_t>(workers, jobs.size())));
+    // Cores the pool leaves idle (fewer jobs than cores) go to the passes
+    // inside each input.
+    FileOptions opts = base;
+    opts.threads = std::max(1u, worker_count() / workers);
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> failed{0};
+    const auto work = [&] {
+        Workspace workspace;
+        FileOptions file_opts = opts;
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < jobs.size();) {
+            const BatchJob& job = jobs[i];
+            file_opts.log_prefix = job.input + ": ";
+            try {
+                symbolize_file(job.input, job.output, workspace, file_opts);
+            } catch (const std::exception& e) {
+                // Most messages already name the file.
+                const std::string what = e.what();
+                if (what.find(job.input) == std::string::npos)
+                    std::fprintf(stderr, "symbolize: %s: %s\n", job.input.c_str(), what.c_str());
+                else
+                    std::fprintf(stderr, "symbolize: %s\n", what.c_str());
+                failed.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (unsigned w = 1; w < workers; ++w)
+        threads.emplace_back(work);
+    work();
+    for (std::thread& t : threads)
+        t.join();
+
+    if (opts.verbose)
+        std::fprintf(stderr, "batch: %zu files on %u workers, %zu failed\n", jobs.size(), workers, failed.load());
+    return failed;
+}
+
+} // namespace symbolize
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "pipeline.h"
+
+namespace symbolize {
+
+struct BatchJob {
+    std::string input;
+    std::string output;
+};
+
+// One `in out` pair per line; blank lines and lines starting with '#' are
+// skipped. Throws Error on any other line.
+std::vector<BatchJob> read_manifest(const std::string& path);
+
+// Symbolizes every job on a pool of `workers` threads, each with its own
+// Workspace, with `opts` (threads and log_prefix are set per job). A failing
+// job is reported on stderr and does not stop the others. Returns the number
+// of failed jobs.
+size_t run_batch(const std::vector<BatchJob>& jobs, unsigned workers, const FileOptions& opts);
+
+} // namespace symbolize
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace symbolize {
+
+// Dense fixed-size bitset over offsets, with word-level access for passes
+// that combine whole ranges at once.
+class Bitset {
+public:
+    Bitset() = default;
+    explicit Bitset(size_t size, bool value = false)
+        : size_(size), words_((size + 63) / 64, value ? ~uint64_t(0) : 0)
+    {
+        trim();
+    }
+
+    size_t size() const { return size_; }
+    bool test(size_t i) const { return words_[i >> 6] >> (i & 63) & 1; }
+    void set(size_t i) { words_[i >> 6] |= uint64_t(1) << (i & 63); }
+    void reset(size_t i) { words_[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+    void assign(size_t i, bool value) { value ? set(i) : reset(i); }
+
+    size_t count() const
+    {
+        size_t n = 0;
+        for (uint64_t w : words_)
+            n += __builtin_popcountll(w);
+        return n;
+    }
+
+    // First set bit at or after `i`, or size() if there is none.
+    size_t next(size_t i) const
+    {
+        if (i >= size_)
+            return size_;
+        size_t w = i >> 6;
+        uint64_t bits = words_[w] & (~uint64_t(0) << (i & 63));
+        while (!bits) {
+            if (++w == words_.size())
+                return size_;
+            bits = words_[w];
+        }
+        return w * 64 + __builtin_ctzll(bits);
+    }
+
+    std::vector<uint64_t>& words() { return words_; }
+    const std::vector<uint64_t>& words() const { return words_; }
+
+private:
+    void trim()
+    {
+        if (size_ & 63)
+            words_.back() &= (uint64_t(1) << (size_ & 63)) - 1;
+    }
+
+    size_t size_ = 0;
+    std::vector<uint64_t> words_;
+};
+
+} // namespace symbolize
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error.h"
+
+namespace symbolize {
+
+// Little helpers for the flat files symbolize keeps besides its output (the
+// signature database, the result cache): host-endian fields, bounds-checked
+// reads. `what` names the file in errors.
+class ByteReader {
+public:
+    ByteReader(const uint8_t* data, size_t size, std::string what) : data_(data), size_(size), what_(std::move(what)) {}
+
+    void bytes(void* out, size_t n)
+    {
+        if (size_ - pos_ < n)
+            throw Error(what_ + ": truncated");
+        std::memcpy(out, data_ + pos_, n);
+        pos_ += n;
+    }
+
+    uint32_t u32()
+    {
+        uint32_t v;
+        bytes(&v, 4);
+        return v;
+    }
+
+    // Checked before allocating: a corrupt length is an error, not a huge
+    // allocation.
+    std::vector<uint8_t> vector(size_t n)
+    {
+        if (size_ - pos_ < n)
+            throw Error(what_ + ": truncated");
+        std::vector<uint8_t> v(n);
+        bytes(v.data(), n);
+        return v;
+    }
+
+    bool at_end() const { return pos_ == size_; }
+    size_t remaining() const { return size_ - pos_; }
+    const std::string& what() const { return what_; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+    std::string what_;
+};
+
+class ByteWriter {
+public:
+    void bytes(const void* data, size_t n)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        out_.insert(out_.end(), p, p + n);
+    }
+
+    void u32(uint32_t v) { bytes(&v, 4); }
+
+    const std::vector<uint8_t>& data() const { return out_; }
+
+private:
+    std::vector<uint8_t> out_;
+};
+
+} // namespace symbolize
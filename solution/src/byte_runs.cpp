@@ -0,0 +1,116 @@
+#include "byte_runs.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SYMBOLIZE_X86_SIMD 1
+#endif
+
+namespace symbolize {
+
+namespace {
+
+// Turns per-byte match masks into runs; state carries across masks.
+class RunCollector {
+public:
+    RunCollector(size_t min_length, std::vector<ByteRun>& runs) : min_length_(min_length), runs_(runs) {}
+
+    // Bit i of `mask` tells whether the byte at base + i matches.
+    void feed(uint64_t mask, size_t base)
+    {
+        unsigned pos = 0;
+        while (pos < 64) {
+            const uint64_t rest = (in_run_ ? ~mask : mask) >> pos;
+            if (rest == 0)
+                return;
+            pos += unsigned(__builtin_ctzll(rest));
+            if (in_run_)
+                close(base + pos);
+            else
+                start_ = base + pos;
+            in_run_ = !in_run_;
+        }
+    }
+
+    void finish(size_t end)
+    {
+        if (in_run_)
+            close(end);
+        in_run_ = false;
+    }
+
+private:
+    void close(size_t end)
+    {
+        if (end - start_ >= min_length_)
+            runs_.push_back({uint32_t(start_), uint32_t(end)});
+    }
+
+    size_t min_length_;
+    std::vector<ByteRun>& runs_;
+    bool in_run_ = false;
+    size_t start_ = 0;
+};
+
+uint64_t match_mask_scalar(const uint8_t* p, size_t n, uint8_t value)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < n; ++i)
+        mask |= uint64_t(p[i] == value) << i;
+    return mask;
+}
+
+#ifdef SYMBOLIZE_X86_SIMD
+
+__attribute__((target("avx2"))) size_t scan_avx2(const uint8_t* data, size_t size, uint8_t value,
+                                                 RunCollector& runs)
+{
+    const __m256i needle = _mm256_set1_epi8(char(value));
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32));
+        const uint64_t mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)))
+            | uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)))) << 32;
+        runs.feed(mask, i);
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) size_t scan_sse2(const uint8_t* data, size_t size, uint8_t value,
+                                                 RunCollector& runs)
+{
+    const __m128i needle = _mm_set1_epi8(char(value));
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        uint64_t mask = 0;
+        for (unsigned part = 0; part < 4; ++part) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + part * 16));
+            mask |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)))) << (part * 16);
+        }
+        runs.feed(mask, i);
+    }
+    return i;
+}
+
+#endif // SYMBOLIZE_X86_SIMD
+
+} // namespace
+
+std::vector<ByteRun> find_byte_runs(const uint8_t* data, size_t size, uint8_t value, size_t min_length)
+{
+    std::vector<ByteRun> runs;
+    RunCollector collector(min_length ? min_length : 1, runs);
+    size_t done = 0;
+#ifdef SYMBOLIZE_X86_SIMD
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    done = avx2 ? scan_avx2(data, size, value, collector) : scan_sse2(data, size, value, collector);
+#endif
+    for (; done < size; done += 64) {
+        const size_t n = size - done < 64 ? size - done : 64;
+        collector.feed(match_mask_scalar(data + done, n, value), done);
+    }
+    collector.finish(size);
+    return runs;
+}
+
+} // namespace symbolize
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace symbolize {
+
+// [begin, end) offsets of a run of equal bytes.
+struct ByteRun {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+
+    uint32_t size() const { return end - begin; }
+};
+
+// Maximal runs of `value` at least `min_length` bytes long, in order. Bytes
+// are compared 32 (AVX2) or 16 (SSE2) at a time and the runs read off the
+// resulting bit masks, 64 offsets per step.
+std::vector<ByteRun> find_byte_runs(const uint8_t* data, size_t size, uint8_t value, size_t min_length = 1);
+
+} // namespace symbolize
@@ -0,0 +1,111 @@
+#include "cfg.h"
+
+#include <algorithm>
+
+namespace symbolize {
+
+namespace {
+
+// Per-offset state while finding the leaders.
+constexpr uint8_t kOnePred = 1;   // one plain fall-through predecessor so far
+constexpr uint8_t kManyPreds = 2; // more than one
+constexpr uint8_t kLeader = 4;    // branch target or after a conditional branch
+
+bool continues_block(Flow flow)
+{
+    return flow == Flow::Sequential || flow == Flow::Call || flow == Flow::IndirectCall;
+}
+
+} // namespace
+
+Cfg build_cfg(const SupersetTable& table, const Bitset& candidates, Arena& scratch, const Bitset* skip)
+{
+    Bitset kept;
+    if (skip) {
+        kept = candidates;
+        for (size_t w = 0; w < kept.words().size(); ++w)
+            kept.words()[w] &= ~skip->words()[w];
+    }
+    const Bitset& is_instr = skip ? kept : candidates;
+    const size_t size = table.size();
+    Cfg cfg(scratch);
+    uint8_t* state = scratch.allocate<uint8_t>(size);
+    std::fill_n(state, size, 0);
+
+    const auto candidate = [&](size_t offset) { return offset < size && is_instr.test(offset); };
+    const auto jump_target = [&](size_t offset, size_t& target) {
+        const Flow flow = table.flow[offset];
+        if (flow != Flow::Jump && flow != Flow::CondJump && flow != Flow::Call)
+            return false;
+        target = table.target[offset] - table.base;
+        return table.contains(table.target[offset]) && is_instr.test(target);
+    };
+
+    for (size_t u = is_instr.next(0); u < size; u = is_instr.next(u + 1)) {
+        const Flow flow = table.flow[u];
+        const size_t next = u + table.length[u];
+        if (falls_through(flow) && candidate(next)) {
+            if (!continues_block(flow))
+                state[next] |= kLeader;
+            else if (state[next] & (kOnePred | kManyPreds))
+                state[next] = uint8_t((state[next] & kLeader) | kManyPreds);
+            else
+                state[next] |= kOnePred;
+        }
+        size_t target;
+        if (jump_target(u, target))
+            state[target] |= kLeader;
+    }
+    const auto leader = [&](size_t offset) { return (state[offset] & (kLeader | kOnePred)) != kOnePred; };
+
+    cfg.block_of.assign(size, Cfg::kNoBlock);
+    uint32_t blocks = 0;
+    for (size_t u = is_instr.next(0); u < size; u = is_instr.next(u + 1))
+        if (leader(u))
+            cfg.block_of[u] = blocks++;
+
+    // Blocks in leader order: the instructions of each, then its successors.
+    cfg.insn_begin.reserve(blocks + 1);
+    cfg.succ_begin.reserve(blocks + 1);
+    cfg.insn_begin.push_back(0);
+    cfg.succ_begin.push_back(0);
+    for (size_t u = is_instr.next(0); u < size; u = is_instr.next(u + 1)) {
+        if (!leader(u))
+            continue;
+        const uint32_t b = cfg.block_of[u];
+        size_t last = u;
+        for (;;) {
+            cfg.insns.push_back(uint32_t(last));
+            cfg.block_of[last] = b;
+            const size_t next = last + table.length[last];
+            if (!continues_block(table.flow[last]) || !candidate(next) || leader(next))
+                break;
+            last = next;
+        }
+        cfg.insn_begin.push_back(uint32_t(cfg.insns.size()));
+
+        const Flow flow = table.flow[last];
+        const size_t next = last + table.length[last];
+        size_t target;
+        if (falls_through(flow) && candidate(next))
+            cfg.succs.push_back(cfg.block_of[next]);
+        if (flow != Flow::Call && jump_target(last, target)
+            && (cfg.succs.size() == cfg.succ_begin.back() || cfg.succs.back() != cfg.block_of[target]))
+            cfg.succs.push_back(cfg.block_of[target]);
+        cfg.succ_begin.push_back(uint32_t(cfg.succs.size()));
+    }
+
+    cfg.pred_begin.assign(blocks + 1, 0);
+    for (uint32_t s : cfg.succs)
+        ++cfg.pred_begin[s + 1];
+    for (uint32_t b = 0; b < blocks; ++b)
+        cfg.pred_begin[b + 1] += cfg.pred_begin[b];
+    cfg.preds.resize(cfg.succs.size());
+    ArenaVector<uint32_t> fill(cfg.pred_begin.begin(), cfg.pred_begin.end() - 1, ArenaAllocator<uint32_t>(scratch));
+    for (uint32_t b = 0; b < blocks; ++b)
+        for (uint32_t s : cfg.successors(b))
+            cfg.preds[fill[s]++] = b;
+    return cfg;
+}
+
+} // namespace symbolize
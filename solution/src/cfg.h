@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include "arena.h"
+#include "bitset.h"
+#include "span.h"
+#include "superset.h"
+
+namespace symbolize {
+
+// Basic blocks of the candidate instructions (is_instr) of the text, in
+// compressed sparse row form: the instructions, successors and predecessors
+// of block b are insns[insn_begin[b] .. insn_begin[b + 1]) and so on. Blocks
+// are numbered by the offset of their first instruction, so a pass that
+// walks them in order streams over each array once; the arrays live in the
+// arena of the run and must not outlive its next reset().
+//
+// A block ends at a branch, a return or trap, or before an instruction that
+// starts a block itself: a jump or call target, or an offset with more than
+// one fall-through predecessor (where overlapping decodings meet). Calls do
+// not end a block; their targets are not successors.
+struct Cfg {
+    static constexpr uint32_t kNoBlock = UINT32_MAX;
+
+    explicit Cfg(Arena& arena)
+        : insn_begin(ArenaAllocator<uint32_t>(arena)), insns(ArenaAllocator<uint32_t>(arena)),
+          succ_begin(ArenaAllocator<uint32_t>(arena)), succs(ArenaAllocator<uint32_t>(arena)),
+          pred_begin(ArenaAllocator<uint32_t>(arena)), preds(ArenaAllocator<uint32_t>(arena)),
+          block_of(ArenaAllocator<uint32_t>(arena))
+    {
+    }
+
+    size_t blocks() const { return insn_begin.empty() ? 0 : insn_begin.size() - 1; }
+
+    Span<uint32_t> instructions(size_t b) const { return row(insn_begin, insns, b); }
+    Span<uint32_t> successors(size_t b) const { return row(succ_begin, succs, b); }
+    Span<uint32_t> predecessors(size_t b) const { return row(pred_begin, preds, b); }
+    uint32_t first(size_t b) const { return insns[insn_begin[b]]; }
+    uint32_t last(size_t b) const { return insns[insn_begin[b + 1] - 1]; }
+
+    ArenaVector<uint32_t> insn_begin; // blocks + 1
+    ArenaVector<uint32_t> insns;      // text offsets
+    ArenaVector<uint32_t> succ_begin; // blocks + 1
+    ArenaVector<uint32_t> succs;      // block numbers
+    ArenaVector<uint32_t> pred_begin; // blocks + 1
+    ArenaVector<uint32_t> preds;      // block numbers
+    ArenaVector<uint32_t> block_of;   // per text offset; kNoBlock if not a candidate
+
+private:
+    static Span<uint32_t> row(const ArenaVector<uint32_t>& begin, const ArenaVector<uint32_t>& items, size_t b)
+    {
+        return {items.data() + begin[b], begin[b + 1] - begin[b]};
+    }
+};
+
+// `skip` offsets are left out, as if they were no candidates.
+Cfg build_cfg(const SupersetTable& table, const Bitset& is_instr, Arena& scratch, const Bitset* skip = nullptr);
+
+} // namespace symbolize
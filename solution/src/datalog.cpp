@@ -0,0 +1,134 @@
+#include "datalog.h"
+
+#include <algorithm>
+
+namespace symbolize::datalog {
+
+size_t RuleContext::end(const RelationBase& rel) const
+{
+    auto it = std::find(inputs_->begin(), inputs_->end(), &rel);
+    return it == inputs_->end() ? rel.size() : (*end_)[it - inputs_->begin()];
+}
+
+size_t RuleContext::seen_end(const RelationBase& rel) const
+{
+    auto it = std::find(inputs_->begin(), inputs_->end(), &rel);
+    return it == inputs_->end() ? 0 : (*seen_)[it - inputs_->begin()];
+}
+
+Program::Program() : strata_(1) {}
+
+void Program::stratum()
+{
+    if (!strata_.back().rules.empty())
+        strata_.emplace_back();
+}
+
+void Program::rule(std::string name, std::vector<const RelationBase*> inputs,
+                   std::vector<const RelationBase*> negated, std::vector<RelationBase*> outputs, Body body)
+{
+    Stratum& stratum = strata_.back();
+    Rule rule;
+    rule.name = std::move(name);
+    rule.seen.assign(inputs.size(), 0);
+    rule.seen_generation.reserve(inputs.size());
+    for (const RelationBase* rel : inputs)
+        rule.seen_generation.push_back(rel->generation());
+    rule.inputs = std::move(inputs);
+    rule.body = std::move(body);
+    stratum.rules.push_back(std::move(rule));
+
+    for (const RelationBase* rel : negated) {
+        if (std::find(stratum.negated.begin(), stratum.negated.end(), rel) == stratum.negated.end()) {
+            stratum.negated.push_back(rel);
+            stratum.negated_state.emplace_back(rel->size(), rel->generation());
+        }
+    }
+    for (RelationBase* rel : outputs)
+        if (std::find(stratum.outputs.begin(), stratum.outputs.end(), rel) == stratum.outputs.end())
+            stratum.outputs.push_back(rel);
+}
+
+void Program::on_reset(std::function<void()> clear)
+{
+    strata_.back().on_reset.push_back(std::move(clear));
+}
+
+bool Program::needs_reset(const Stratum& stratum) const
+{
+    if (!stratum.evaluated)
+        return false;
+    for (size_t i = 0; i < stratum.negated.size(); ++i) {
+        const RelationBase* rel = stratum.negated[i];
+        if (rel->size() != stratum.negated_state[i].first || rel->generation() != stratum.negated_state[i].second)
+            return true;
+    }
+    // A positive input re-derived from scratch may have lost rows we built on.
+    for (const Rule& rule : stratum.rules)
+        for (size_t i = 0; i < rule.inputs.size(); ++i)
+            if (rule.inputs[i]->generation() != rule.seen_generation[i])
+                return true;
+    return false;
+}
+
+void Program::reset(Stratum& stratum)
+{
+    for (RelationBase* rel : stratum.outputs)
+        rel->clear();
+    for (const auto& clear : stratum.on_reset)
+        clear();
+    // Facts fire again.
+    stratum.evaluated = false;
+    for (Rule& rule : stratum.rules) {
+        std::fill(rule.seen.begin(), rule.seen.end(), 0);
+        for (size_t i = 0; i < rule.inputs.size(); ++i)
+            rule.seen_generation[i] = rule.inputs[i]->generation();
+    }
+}
+
+size_t Program::evaluate(Stratum& stratum)
+{
+    if (needs_reset(stratum))
+        reset(stratum);
+
+    size_t evaluations = 0;
+    std::vector<size_t> end;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (Rule& rule : stratum.rules) {
+            end.resize(rule.inputs.size());
+            bool pending = rule.inputs.empty() && !stratum.evaluated;
+            for (size_t i = 0; i < rule.inputs.size(); ++i) {
+                end[i] = rule.inputs[i]->size();
+                pending |= end[i] != rule.seen[i];
+            }
+            if (!pending)
+                continue;
+
+            RuleContext ctx;
+            ctx.inputs_ = &rule.inputs;
+            ctx.seen_ = &rule.seen;
+            ctx.end_ = &end;
+            rule.body(ctx);
+            rule.seen = end;
+            ++evaluations;
+            changed = true;
+        }
+        // Rules without inputs (facts) only fire once.
+        stratum.evaluated = true;
+    }
+
+    for (size_t i = 0; i < stratum.negated.size(); ++i)
+        stratum.negated_state[i] = {stratum.negated[i]->size(), stratum.negated[i]->generation()};
+    return evaluations;
+}
+
+size_t Program::run()
+{
+    size_t evaluations = 0;
+    for (Stratum& stratum : strata_)
+        evaluations += evaluate(stratum);
+    return evaluations;
+}
+
+} // namespace symbolize::datalog
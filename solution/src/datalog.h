@@ -0,0 +1,194 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace symbolize::datalog {
+
+using Value = uint32_t;
+
+// Rows [begin, end) of a relation.
+struct Range {
+    size_t begin = 0;
+    size_t end = 0;
+
+    bool empty() const { return begin == end; }
+};
+
+class RelationBase {
+public:
+    explicit RelationBase(std::string name) : name_(std::move(name)) {}
+    virtual ~RelationBase() = default;
+    RelationBase(const RelationBase&) = delete;
+    RelationBase& operator=(const RelationBase&) = delete;
+
+    const std::string& name() const { return name_; }
+    virtual size_t size() const = 0;
+    virtual void clear() = 0;
+
+    // Bumped on clear(): rows seen before that are gone.
+    uint64_t generation() const { return generation_; }
+
+protected:
+    uint64_t generation_ = 0;
+    std::string name_;
+};
+
+// An append-only set of tuples stored column by column, with an index on the
+// first column. Rows keep their insertion order, which is what makes the
+// semi-naive evaluation below possible: a rule only needs the rows appended
+// since it last ran.
+template <size_t Arity>
+class Relation final : public RelationBase {
+public:
+    using Tuple = std::array<Value, Arity>;
+
+    using RelationBase::RelationBase;
+
+    size_t size() const override { return columns_[0].size(); }
+
+    void clear() override
+    {
+        for (auto& column : columns_)
+            column.clear();
+        tuples_.clear();
+        index_.clear();
+        ++generation_;
+    }
+
+    bool insert(const Tuple& tuple)
+    {
+        if (!tuples_.insert(tuple).second)
+            return false;
+        index_[tuple[0]].push_back(uint32_t(size()));
+        for (size_t c = 0; c < Arity; ++c)
+            columns_[c].push_back(tuple[c]);
+        return true;
+    }
+
+    bool contains(const Tuple& tuple) const { return tuples_.count(tuple) != 0; }
+    bool contains_key(Value key) const { return index_.count(key) != 0; }
+
+    Value at(size_t row, size_t column) const { return columns_[column][row]; }
+    const std::vector<Value>& column(size_t c) const { return columns_[c]; }
+
+    Tuple row(size_t r) const
+    {
+        Tuple tuple;
+        for (size_t c = 0; c < Arity; ++c)
+            tuple[c] = columns_[c][r];
+        return tuple;
+    }
+
+    // Calls fn(row) for the rows below `end` whose first column is `key`.
+    template <typename Fn>
+    void for_key(Value key, size_t end, Fn&& fn) const
+    {
+        auto it = index_.find(key);
+        if (it == index_.end())
+            return;
+        for (uint32_t r : it->second) {
+            if (r >= end)
+                break;
+            fn(size_t(r));
+        }
+    }
+
+private:
+    struct TupleHash {
+        size_t operator()(const Tuple& tuple) const
+        {
+            uint64_t h = 0x9E3779B97F4A7C15ull;
+            for (Value v : tuple)
+                h = (h ^ v) * 0xFF51AFD7ED558CCDull;
+            return size_t(h ^ (h >> 32));
+        }
+    };
+
+    std::array<std::vector<Value>, Arity> columns_;
+    std::unordered_set<Tuple, TupleHash> tuples_;
+    std::unordered_map<Value, std::vector<uint32_t>> index_;
+};
+
+class Program;
+
+// What a rule body sees of its inputs during one evaluation. A rule reading
+// A and B derives everything by joining delta(A) with all(B) and seen(A) with
+// delta(B).
+class RuleContext {
+public:
+    Range delta(const RelationBase& rel) const { return {seen_end(rel), end(rel)}; }
+    Range seen(const RelationBase& rel) const { return {0, seen_end(rel)}; }
+    Range all(const RelationBase& rel) const { return {0, end(rel)}; }
+    size_t end(const RelationBase& rel) const;
+
+private:
+    friend class Program;
+    size_t seen_end(const RelationBase& rel) const;
+
+    const std::vector<const RelationBase*>* inputs_ = nullptr;
+    const std::vector<size_t>* seen_ = nullptr;
+    const std::vector<size_t>* end_ = nullptr;
+};
+
+// Rules grouped into strata and evaluated semi-naively to a fixpoint.
+//
+// Every rule remembers how many rows of each input it has consumed, so rules
+// and input facts added after a run only cost the work they cause. A rule may
+// negate relations of earlier strata only; when such a relation grows, the
+// stratum is re-derived from scratch, along with every stratum reading it.
+class Program {
+public:
+    using Body = std::function<void(const RuleContext&)>;
+
+    Program();
+
+    // Starts a new stratum for the rules registered next.
+    void stratum();
+
+    // `inputs` are read positively (their new rows trigger the rule),
+    // `negated` through negation or by lookup only, and `outputs` are the
+    // relations it derives.
+    void rule(std::string name, std::vector<const RelationBase*> inputs,
+              std::vector<const RelationBase*> negated, std::vector<RelationBase*> outputs, Body body);
+
+    // Runs `clear` whenever the current stratum is re-derived from scratch,
+    // for the state its rule bodies keep outside of relations.
+    void on_reset(std::function<void()> clear);
+
+    // Evaluates every stratum to its fixpoint. Returns the number of rule
+    // evaluations it took.
+    size_t run();
+
+private:
+    struct Rule {
+        std::string name;
+        std::vector<const RelationBase*> inputs;
+        std::vector<size_t> seen;
+        std::vector<uint64_t> seen_generation;
+        Body body;
+    };
+
+    struct Stratum {
+        std::vector<Rule> rules;
+        std::vector<RelationBase*> outputs;
+        std::vector<const RelationBase*> negated;
+        std::vector<std::pair<size_t, uint64_t>> negated_state; // size and generation at last run
+        std::vector<std::function<void()>> on_reset;
+        bool evaluated = false;
+    };
+
+    bool needs_reset(const Stratum& stratum) const;
+    void reset(Stratum& stratum);
+    size_t evaluate(Stratum& stratum);
+
+    std::vector<Stratum> strata_;
+};
+
+} // namespace symbolize::datalog
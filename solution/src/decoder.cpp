@@ -0,0 +1,506 @@
+#include "decoder.h"
+
+#include <array>
+#include <cstring>
+
+namespace symbolize {
+
+namespace {
+
+constexpr unsigned kMaxLength = 15;
+
+enum class Imm : uint8_t {
+    None,
+    Imm8,
+    Imm16,
+    ImmZ,   // imm16 with 0x66, imm32 otherwise
+    Rel8,
+    Rel32,
+    Enter,  // imm16, imm8
+    Moffs,  // 32-bit absolute address (no 16-bit addressing on IA-MCU)
+};
+
+// Opcode groups whose immediate or flow depend on ModRM.reg; rows of kGroups.
+enum Group : uint8_t { kNoGroup, kGroupF6, kGroupF7, kGroupFF };
+
+struct OpcodeInfo {
+    bool valid = false;
+    bool modrm = false;
+    Imm imm = Imm::None;
+    Flow flow = Flow::Sequential;
+    // The ModRM.reg values that are valid with a register operand (mod 3)
+    // and with a memory operand, one bit each.
+    uint8_t reg_mask[2] = {0xFF, 0xFF};
+    Group group = kNoGroup;
+
+    constexpr bool modrm_dependent() const { return group != kNoGroup || reg_mask[0] != 0xFF || reg_mask[1] != 0xFF; }
+};
+
+struct GroupShape {
+    Imm imm;
+    Flow flow;
+};
+
+constexpr GroupShape kSeq{Imm::None, Flow::Sequential};
+
+constexpr GroupShape kGroups[][8] = {
+    {kSeq, kSeq, kSeq, kSeq, kSeq, kSeq, kSeq, kSeq},
+    {{Imm::Imm8, Flow::Sequential}, kSeq, kSeq, kSeq, kSeq, kSeq, kSeq, kSeq}, // test r/m8, imm8
+    {{Imm::ImmZ, Flow::Sequential}, kSeq, kSeq, kSeq, kSeq, kSeq, kSeq, kSeq}, // test r/m32, imm32
+    {kSeq, kSeq, {Imm::None, Flow::IndirectCall}, kSeq, {Imm::None, Flow::IndirectJump}, kSeq, kSeq, kSeq},
+};
+
+constexpr OpcodeInfo kInvalid{};
+
+constexpr OpcodeInfo op(bool modrm, Imm imm = Imm::None, Flow flow = Flow::Sequential)
+{
+    OpcodeInfo info;
+    info.valid = true;
+    info.modrm = modrm;
+    info.imm = imm;
+    info.flow = flow;
+    return info;
+}
+
+// An opcode taking only some ModRM.reg values (or no register operand).
+constexpr OpcodeInfo modrm_op(uint8_t with_register, uint8_t with_memory, Group group = kNoGroup)
+{
+    OpcodeInfo info = op(true);
+    info.reg_mask[0] = with_register;
+    info.reg_mask[1] = with_memory;
+    info.group = group;
+    return info;
+}
+
+constexpr OpcodeInfo modrm_op(uint8_t regs, Imm imm)
+{
+    OpcodeInfo info = modrm_op(regs, regs);
+    info.imm = imm;
+    return info;
+}
+
+constexpr OpcodeInfo one_byte_info(uint8_t opcode)
+{
+    if (opcode < 0x40) {
+        // The eight ALU operations share one layout; columns 6 and 7 are
+        // segment register push/pop, segment prefixes or BCD adjustments.
+        switch (opcode & 7) {
+        case 0: case 1: case 2: case 3: return op(true);
+        case 4: return op(false, Imm::Imm8);
+        case 5: return op(false, Imm::ImmZ);
+        default: return kInvalid;
+        }
+    }
+    if (opcode < 0x60)
+        return op(false); // inc, dec, push, pop r32
+    if (opcode >= 0x70 && opcode < 0x80)
+        return op(false, Imm::Rel8, Flow::CondJump);
+    if (opcode >= 0x90 && opcode < 0x9A)
+        return op(false); // xchg, nop, cwde, cdq
+    if (opcode >= 0xB0 && opcode < 0xB8)
+        return op(false, Imm::Imm8);
+    if (opcode >= 0xB8 && opcode < 0xC0)
+        return op(false, Imm::ImmZ);
+
+    switch (opcode) {
+    case 0x60: case 0x61: return op(false); // pusha, popa
+    case 0x68: return op(false, Imm::ImmZ);
+    case 0x69: return op(true, Imm::ImmZ);
+    case 0x6A: return op(false, Imm::Imm8);
+    case 0x6B: return op(true, Imm::Imm8);
+    case 0x80: case 0x83: return op(true, Imm::Imm8);
+    case 0x81: return op(true, Imm::ImmZ);
+    case 0x84: case 0x85: case 0x86: case 0x87:
+    case 0x88: case 0x89: case 0x8A: case 0x8B:
+        return op(true);
+    case 0x8D: return modrm_op(0x00, 0xFF); // lea: memory operands only
+    case 0x8F: return modrm_op(0x01, 0x01); // pop r/m32
+    case 0x9C: case 0x9D: case 0x9E: case 0x9F: return op(false); // pushf, popf, sahf, lahf
+    case 0xA0: case 0xA1: case 0xA2: case 0xA3: return op(false, Imm::Moffs);
+    case 0xA4: case 0xA5: case 0xA6: case 0xA7: return op(false); // movs, cmps
+    case 0xA8: return op(false, Imm::Imm8);
+    case 0xA9: return op(false, Imm::ImmZ);
+    case 0xAA: case 0xAB: case 0xAC: case 0xAD: case 0xAE: case 0xAF: return op(false);
+    case 0xC0: case 0xC1: return modrm_op(0xBF, Imm::Imm8); // shifts, no /6
+    case 0xC2: return op(false, Imm::Imm16, Flow::Return);
+    case 0xC3: return op(false, Imm::None, Flow::Return);
+    case 0xC6: return modrm_op(0x01, Imm::Imm8);
+    case 0xC7: return modrm_op(0x01, Imm::ImmZ);
+    case 0xC8: return op(false, Imm::Enter);
+    case 0xC9: return op(false); // leave
+    case 0xCC: return op(false, Imm::None, Flow::Trap);
+    case 0xCD: return op(false, Imm::Imm8); // int imm8 (syscalls)
+    case 0xD0: case 0xD1: case 0xD2: case 0xD3: return modrm_op(0xBF, 0xBF);
+    case 0xE0: case 0xE1: case 0xE2: case 0xE3: return op(false, Imm::Rel8, Flow::CondJump);
+    case 0xE8: return op(false, Imm::Rel32, Flow::Call);
+    case 0xE9: return op(false, Imm::Rel32, Flow::Jump);
+    case 0xEB: return op(false, Imm::Rel8, Flow::Jump);
+    case 0xF4: case 0xF5: return op(false); // hlt, cmc
+    case 0xF6: return modrm_op(0xFD, 0xFD, kGroupF6); // no /1
+    case 0xF7: return modrm_op(0xFD, 0xFD, kGroupF7);
+    case 0xF8: case 0xF9: case 0xFC: case 0xFD: return op(false); // clc, stc, cld, std
+    case 0xFE: return modrm_op(0x03, 0x03); // inc, dec r/m8
+    case 0xFF: return modrm_op(0x57, 0x57, kGroupFF); // no far call/jmp, no /7
+    default: return kInvalid;
+    }
+}
+
+constexpr OpcodeInfo two_byte_info(uint8_t opcode)
+{
+    if (opcode >= 0x80 && opcode < 0x90)
+        return op(false, Imm::Rel32, Flow::CondJump);
+    if (opcode >= 0x90 && opcode < 0xA0)
+        return op(true); // setcc
+    if (opcode >= 0xC8)
+        return op(false); // bswap
+
+    switch (opcode) {
+    case 0x0B: return op(false, Imm::None, Flow::Trap); // ud2
+    case 0x1F: return modrm_op(0x01, 0x01); // multi-byte nop
+    case 0x31: return op(false); // rdtsc
+    case 0xA2: return op(false); // cpuid
+    case 0xA3: case 0xAB: case 0xB3: case 0xBB: return op(true); // bt*
+    case 0xA4: case 0xAC: return op(true, Imm::Imm8); // shld/shrd imm8
+    case 0xA5: case 0xAD: return op(true); // shld/shrd cl
+    case 0xAF: return op(true); // imul
+    case 0xB0: case 0xB1: return op(true); // cmpxchg
+    case 0xB6: case 0xB7: case 0xBE: case 0xBF: return op(true); // movzx, movsx
+    case 0xBA: return modrm_op(0xF0, Imm::Imm8); // bt* imm8: /4 to /7
+    case 0xBC: case 0xBD: return op(true); // bsf, bsr
+    case 0xC0: case 0xC1: return op(true); // xadd
+    case 0xC7: return modrm_op(0x00, 0x02); // cmpxchg8b m64
+    default: return kInvalid;
+    }
+}
+
+template <typename Info>
+constexpr std::array<OpcodeInfo, 256> make_table(Info info)
+{
+    std::array<OpcodeInfo, 256> table{};
+    for (unsigned opcode = 0; opcode < 256; ++opcode)
+        table[opcode] = info(uint8_t(opcode));
+    return table;
+}
+
+// Both opcode maps, generated at compile time: a decode looks its opcode up
+// instead of branching through the switches above.
+constexpr std::array<OpcodeInfo, 256> kOneByte = make_table(one_byte_info);
+constexpr std::array<OpcodeInfo, 256> kTwoByte = make_table(two_byte_info);
+
+static_assert(kOneByte[0xE8].flow == Flow::Call && kOneByte[0xE8].imm == Imm::Rel32, "call rel32");
+static_assert(kOneByte[0xFF].modrm_dependent() && !kOneByte[0x89].modrm_dependent(), "ModRM groups");
+static_assert(!kOneByte[0x0F].valid && !kOneByte[0xD8].valid && !kTwoByte[0x10].valid,
+              "escape, x87 and SSE opcodes are not lakemont instructions");
+
+size_t immediate_size(Imm imm, bool opsize16)
+{
+    switch (imm) {
+    case Imm::None: return 0;
+    case Imm::Imm8: case Imm::Rel8: return 1;
+    case Imm::Imm16: return 2;
+    case Imm::ImmZ: return opsize16 ? 2 : 4;
+    case Imm::Rel32: case Imm::Moffs: return 4;
+    case Imm::Enter: return 3;
+    }
+    return 0;
+}
+
+uint32_t read32(const uint8_t* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+} // namespace
+
+OpcodeShape one_byte_shape(uint8_t opcode)
+{
+    OpcodeShape shape;
+    const OpcodeInfo& info = kOneByte[opcode];
+    if (!info.valid)
+        return shape;
+    shape.valid = true;
+    shape.modrm = info.modrm;
+    shape.modrm_dependent = info.modrm_dependent();
+    shape.flow = info.flow;
+    shape.moffs = info.imm == Imm::Moffs;
+    shape.imm_size = immediate_size(info.imm, false);
+    return shape;
+}
+
+DecodeStatus decode(const uint8_t* code, size_t available, uint32_t address, Instruction& out)
+{
+    out = Instruction{};
+    const size_t limit = available < kMaxLength ? available : kMaxLength;
+    const auto truncated = [&] { return available < kMaxLength ? DecodeStatus::Truncated : DecodeStatus::Invalid; };
+    size_t pos = 0;
+
+    for (;; ++pos) {
+        if (pos >= limit)
+            return truncated();
+        const uint8_t byte = code[pos];
+        if (byte == 0x66)
+            out.opsize16 = true;
+        else if (byte == 0xF2 || byte == 0xF3)
+            out.rep = true;
+        else if (byte == 0xF0)
+            out.lock = true;
+        else if (byte == 0x67)
+            out.addr16 = true;
+        else
+            break;
+    }
+    out.prefix_count = pos;
+
+    const OpcodeInfo* info;
+    if (code[pos] == 0x0F) {
+        if (++pos >= limit)
+            return truncated();
+        out.opcode = 0x100 | code[pos];
+        info = &kTwoByte[code[pos]];
+    } else {
+        out.opcode = code[pos];
+        info = &kOneByte[code[pos]];
+    }
+    ++pos;
+    if (!info->valid)
+        return DecodeStatus::Invalid;
+    Imm imm = info->imm;
+    Flow flow = info->flow;
+    // ld relaxes `call *sym@GOT(%reg)` to `addr32 call sym`; any other use of
+    // 0x67 would mean 16-bit addressing.
+    if (out.addr16 && out.opcode != 0xE8)
+        return DecodeStatus::Invalid;
+
+    if (info->modrm) {
+        if (pos >= limit)
+            return truncated();
+        out.has_modrm = true;
+        out.modrm = code[pos++];
+        if (!(info->reg_mask[out.mod() != 3] >> out.reg() & 1))
+            return DecodeStatus::Invalid;
+        if (info->group != kNoGroup) {
+            const GroupShape& shape = kGroups[info->group][out.reg()];
+            imm = shape.imm;
+            flow = shape.flow;
+        }
+
+        const uint8_t mod = out.mod();
+        size_t disp_size = mod == 1 ? 1 : mod == 2 ? 4 : 0;
+        if (mod != 3 && out.rm() == 4) {
+            if (pos >= limit)
+                return truncated();
+            out.has_sib = true;
+            out.sib = code[pos++];
+            if (mod == 0 && (out.sib & 7) == 5)
+                disp_size = 4;
+        } else if (mod == 0 && out.rm() == 5) {
+            disp_size = 4;
+        }
+        if (pos + disp_size > limit)
+            return truncated();
+        if (disp_size == 4) {
+            out.disp_offset = pos;
+            out.disp = int32_t(read32(code + pos));
+        } else if (disp_size == 1) {
+            out.disp = int8_t(code[pos]);
+        }
+        pos += disp_size;
+    }
+
+    // 0x66 would truncate EIP to 16 bits: not something IA-MCU code does.
+    if (imm == Imm::Rel32 && out.opsize16)
+        return DecodeStatus::Invalid;
+    const size_t imm_size = immediate_size(imm, out.opsize16);
+    if (pos + imm_size > limit)
+        return truncated();
+
+    if (imm == Imm::Moffs) {
+        out.disp_offset = pos;
+        out.disp = int32_t(read32(code + pos));
+    } else if (imm_size == 4) {
+        out.imm_offset = pos;
+        out.imm = read32(code + pos);
+    } else if (imm_size == 2) {
+        out.imm = uint32_t(code[pos]) | uint32_t(code[pos + 1]) << 8;
+    } else if (imm_size == 1) {
+        out.imm = imm == Imm::Rel8 ? uint32_t(int32_t(int8_t(code[pos]))) : code[pos];
+    } else if (imm_size == 3) {
+        out.imm = uint32_t(code[pos]) | uint32_t(code[pos + 1]) << 8;
+    }
+    pos += imm_size;
+
+    out.length = pos;
+    out.flow = flow;
+    if (imm == Imm::Rel8 || imm == Imm::Rel32)
+        out.target = address + out.length + out.imm;
+    return DecodeStatus::Ok;
+}
+
+uint8_t written_registers(const Instruction& insn)
+{
+    constexpr uint8_t kEax = 1 << 0, kEcx = 1 << 1, kEdx = 1 << 2, kEbp = 1 << 5, kEsi = 1 << 6, kEdi = 1 << 7;
+    const uint16_t opcode = insn.opcode;
+    const uint8_t reg = uint8_t(1 << insn.reg());
+    const uint8_t rm = insn.mod() == 3 ? uint8_t(1 << insn.rm()) : 0;
+    // 8-bit operands: al..bl, then ah..bh of the same four registers.
+    const uint8_t reg8 = uint8_t(1 << (insn.reg() & 3));
+    const uint8_t rm8 = insn.mod() == 3 ? uint8_t(1 << (insn.rm() & 3)) : 0;
+
+    if (opcode >= 0xE0 && opcode <= 0xE2) // loop*
+        return kEcx;
+    switch (insn.flow) {
+    case Flow::Call: case Flow::IndirectCall: return kCallerSaved;
+    case Flow::Jump: case Flow::CondJump: case Flow::Return: case Flow::IndirectJump: case Flow::Trap: return 0;
+    default: break;
+    }
+
+    // add, or, adc, sbb, and, sub, xor, cmp: r/m8, r/m32, r8, r32, al, eax.
+    if (opcode < 0x40 && (opcode & 7) < 6) {
+        if (opcode >> 3 == 7)
+            return 0;
+        switch (opcode & 7) {
+        case 0: return rm8;
+        case 1: return rm;
+        case 2: return reg8;
+        case 3: return reg;
+        default: return kEax;
+        }
+    }
+    if (opcode >= 0x40 && opcode < 0x50) // inc, dec
+        return uint8_t(1 << (opcode & 7));
+    if (opcode >= 0x50 && opcode < 0x58) // push
+        return 0;
+    if (opcode >= 0x58 && opcode < 0x60) // pop
+        return uint8_t(1 << (opcode & 7));
+    if (opcode >= 0x91 && opcode < 0x98) // xchg %eax,%reg
+        return uint8_t(kEax | 1 << (opcode & 7));
+    if (opcode >= 0xB0 && opcode < 0xB8)
+        return uint8_t(1 << (opcode & 3));
+    if (opcode >= 0xB8 && opcode < 0xC0)
+        return uint8_t(1 << (opcode & 7));
+    if (opcode >= 0x190 && opcode < 0x1A0) // setcc
+        return rm8;
+    if (opcode >= 0x1C8) // bswap
+        return uint8_t(1 << (opcode & 7));
+
+    switch (opcode) {
+    case 0x60: case 0x68: case 0x6A: case 0x84: case 0x85: case 0x90: case 0x9C: case 0x9D: case 0x9E:
+    case 0xA2: case 0xA3: case 0xA8: case 0xA9: case 0xF4: case 0xF5: case 0xF8: case 0xF9: case 0xFC: case 0xFD:
+    case 0x11F: case 0x1A3:
+        return 0;
+    case 0x69: case 0x6B: case 0x8B: case 0x8D: case 0x1AF: case 0x1B6: case 0x1B7: case 0x1BC: case 0x1BD:
+    case 0x1BE: case 0x1BF:
+        return reg;
+    case 0x8A: return reg8;
+    case 0x88: case 0xC6: case 0xC0: case 0xD0: case 0xD2: return rm8;
+    case 0x89: case 0x8F: case 0xC7: case 0xC1: case 0xD1: case 0xD3: case 0x1A4: case 0x1A5: case 0x1AB:
+    case 0x1AC: case 0x1AD: case 0x1B3: case 0x1BB:
+        return rm;
+    case 0x80: case 0x82: return insn.reg() == 7 ? 0 : rm8;
+    case 0x81: case 0x83: return insn.reg() == 7 ? 0 : rm;
+    case 0x86: return uint8_t(reg8 | rm8);
+    case 0x87: case 0x1C0: case 0x1C1: return uint8_t(reg | rm);
+    case 0x1B0: case 0x1B1: return uint8_t(kEax | rm);
+    case 0x1BA: return insn.reg() >= 5 ? rm : 0;
+    case 0x98: case 0x9F: case 0xA0: case 0xA1: case 0xCD: return kEax; // int: the syscall result
+    case 0x99: return kEdx;
+    case 0xC8: case 0xC9: return kEbp;
+    case 0x131: return kEax | kEdx;
+    case 0x1A2: return kCallerSaved | 1 << 3; // cpuid: and %ebx
+    case 0xA4: case 0xA5: case 0xA6: case 0xA7: case 0xAA: case 0xAB: case 0xAC: case 0xAD: case 0xAE: case 0xAF:
+        return kEax | kEcx | kEsi | kEdi; // string operations, rep counting %ecx down
+    case 0xF6: case 0xF7:
+        if (insn.reg() < 2)
+            return 0; // test
+        if (insn.reg() < 4)
+            return opcode == 0xF6 ? rm8 : rm; // not, neg
+        return kEax | kEdx; // mul, imul, div, idiv
+    case 0xFE: case 0xFF:
+        if (insn.reg() < 2)
+            return opcode == 0xFE ? rm8 : rm; // inc, dec
+        return 0; // push
+    default:
+        return kAllRegisters;
+    }
+}
+
+uint8_t read_registers(const Instruction& insn)
+{
+    constexpr uint8_t kEax = 1 << 0, kEcx = 1 << 1, kEdx = 1 << 2, kEbp = 1 << 5, kEsi = 1 << 6, kEdi = 1 << 7;
+    constexpr uint8_t kNotEsp = 0xEF;
+    const uint16_t opcode = insn.opcode;
+    if (opcode == 0x11F || opcode == 0x90)
+        return 0;
+
+    uint8_t address = 0;
+    if (insn.has_memory_operand()) {
+        if (insn.has_sib) {
+            const uint8_t base = insn.sib & 7, index = (insn.sib >> 3) & 7;
+            if (!(insn.mod() == 0 && base == 5))
+                address |= uint8_t(1 << base);
+            if (index != 4)
+                address |= uint8_t(1 << index);
+        } else if (!(insn.mod() == 0 && insn.rm() == 5)) {
+            address |= uint8_t(1 << insn.rm());
+        }
+    }
+    const uint8_t reg = uint8_t(1 << insn.reg());
+    const uint8_t rm = insn.mod() == 3 ? uint8_t(1 << insn.rm()) : 0;
+    const uint8_t reg8 = uint8_t(1 << (insn.reg() & 3));
+    const uint8_t rm8 = insn.mod() == 3 ? uint8_t(1 << (insn.rm() & 3)) : 0;
+
+    uint8_t values = 0;
+    if (opcode < 0x40 && (opcode & 7) < 6) {
+        const bool zeroing = ((opcode >> 3) == 5 || (opcode >> 3) == 6) && insn.mod() == 3 && insn.reg() == insn.rm();
+        if (!zeroing)
+            values = (opcode & 7) >= 4 ? kEax : (opcode & 1) ? uint8_t(reg | rm) : uint8_t(reg8 | rm8);
+    } else if (opcode >= 0x40 && opcode < 0x58) { // inc, dec, push
+        values = uint8_t(1 << (opcode & 7));
+    } else if (opcode >= 0x91 && opcode < 0x98) { // xchg %eax,%reg
+        values = uint8_t(kEax | 1 << (opcode & 7));
+    } else if (opcode >= 0x1C8) { // bswap
+        values = uint8_t(1 << (opcode & 7));
+    } else {
+        switch (opcode) {
+        case 0x69: case 0x6B: case 0x8B: case 0x1B7: case 0x1BA: case 0x1BC: case 0x1BD: case 0x1BF: case 0x81:
+        case 0x83: case 0xC1: case 0xD1:
+            values = rm;
+            break;
+        case 0x80: case 0x82: case 0x8A: case 0x1B6: case 0x1BE: case 0xC0: case 0xD0:
+            values = rm8;
+            break;
+        case 0xD2: values = uint8_t(rm8 | kEcx); break;
+        case 0xD3: values = uint8_t(rm | kEcx); break;
+        case 0x84: case 0x86: values = uint8_t(reg8 | rm8); break;
+        case 0x85: case 0x87: case 0x1AF: case 0x1A3: case 0x1AB: case 0x1B3: case 0x1BB: case 0x1A4: case 0x1AC:
+        case 0x1C0: case 0x1C1:
+            values = uint8_t(reg | rm);
+            break;
+        case 0x1A5: case 0x1AD: values = uint8_t(reg | rm | kEcx); break;
+        case 0x1B0: case 0x1B1: values = uint8_t(kEax | reg | rm); break;
+        case 0x88: values = reg8; break;
+        case 0x89: values = reg; break;
+        case 0x98: case 0x99: case 0xA2: case 0xA3: case 0xA8: case 0xA9: case 0xCD: values = kEax; break;
+        case 0xA4: case 0xA5: case 0xA6: case 0xA7: case 0xAA: case 0xAB: case 0xAC: case 0xAD: case 0xAE: case 0xAF:
+            values = kEax | kEcx | kEsi | kEdi;
+            break;
+        case 0xC9: values = kEbp; break; // leave
+        case 0x1A2: values = kEax | kEcx; break; // cpuid
+        case 0xF6: case 0xF7:
+            values = opcode == 0xF6 ? rm8 : rm;
+            if (insn.reg() >= 4)
+                values |= insn.reg() >= 6 ? kEax | kEdx : kEax; // div reads both halves
+            break;
+        case 0xFE: case 0xFF:
+            values = opcode == 0xFE ? rm8 : rm;
+            break;
+        default:
+            break;
+        }
+    }
+    return uint8_t((values | address) & kNotEsp);
+}
+
+} // namespace symbolize
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace symbolize {
+
+// How an instruction hands over control.
+enum class Flow : uint8_t {
+    Invalid,      // not a valid lakemont encoding
+    Sequential,   // falls through to the next instruction
+    Jump,         // jmp rel8/rel32
+    CondJump,     // jcc, loop*, jecxz: falls through or jumps
+    Call,         // call rel32: falls through after the callee returns
+    Return,       // ret, ret imm16
+    IndirectJump, // jmp r/m32
+    IndirectCall, // call r/m32
+    Trap,         // int3, ud2: never falls through
+};
+
+inline bool falls_through(Flow flow)
+{
+    return flow == Flow::Sequential || flow == Flow::CondJump || flow == Flow::Call
+        || flow == Flow::IndirectCall;
+}
+
+inline bool has_direct_target(Flow flow)
+{
+    return flow == Flow::Jump || flow == Flow::CondJump || flow == Flow::Call;
+}
+
+enum class DecodeStatus : uint8_t {
+    Ok,
+    Invalid,   // no lakemont instruction starts with these bytes
+    Truncated, // the encoding needs more bytes than were available
+};
+
+// A fully decoded instruction. Field offsets are relative to its first byte;
+// only 4-byte fields are recorded as they are the only relocatable ones.
+struct Instruction {
+    uint8_t length = 0;
+    Flow flow = Flow::Invalid;
+    uint8_t prefix_count = 0;
+    bool opsize16 = false;  // 0x66
+    bool rep = false;       // 0xF2/0xF3
+    bool lock = false;      // 0xF0
+    bool addr16 = false;    // 0x67
+    uint16_t opcode = 0;    // 0x0F-escaped opcodes are 0x100 | second byte
+    bool has_modrm = false;
+    uint8_t modrm = 0;
+    bool has_sib = false;
+    uint8_t sib = 0;
+    uint8_t disp_offset = 0; // 0 when there is no disp32
+    uint8_t imm_offset = 0;  // 0 when there is no imm32/rel32
+    int32_t disp = 0;
+    uint32_t imm = 0;
+    uint32_t target = 0;     // absolute target of direct branches
+
+    uint8_t mod() const { return modrm >> 6; }
+    uint8_t reg() const { return (modrm >> 3) & 7; }
+    uint8_t rm() const { return modrm & 7; }
+    bool has_memory_operand() const { return has_modrm && mod() != 3; }
+};
+
+// Static shape of a one-byte opcode without prefixes, for fast paths that
+// skip the general decoder.
+struct OpcodeShape {
+    bool valid = false;
+    bool modrm = false;
+    bool modrm_dependent = false; // validity, immediate or flow depend on ModRM.reg
+    bool moffs = false;           // A0-A3: the 4-byte field is an address
+    uint8_t imm_size = 0;         // without a 0x66 prefix
+    Flow flow = Flow::Invalid;
+};
+
+OpcodeShape one_byte_shape(uint8_t opcode);
+
+// Register numbers as in ModRM: eax, ecx, edx, ebx, esp, ebp, esi, edi.
+constexpr uint8_t kCallerSaved = 0x07; // eax, ecx, edx
+constexpr uint8_t kAllRegisters = 0xFF;
+
+// General registers an instruction may change, one bit per register number;
+// byte and word writes count as writes of the whole register. A call changes
+// the caller-saved registers, as the callee is free to; esp is left out.
+uint8_t written_registers(const Instruction& insn);
+
+// General registers an instruction reads as values or in its address: the
+// sources, read-modify-write destinations and base/index registers, but not
+// esp. Zeroing idioms (xor/sub %reg,%reg) and nops read nothing. Instructions
+// not modelled read nothing, so callers that reject on reads stay safe.
+uint8_t read_registers(const Instruction& insn);
+
+// Decodes one instruction of the lakemont subset used by IA-MCU code:
+// no x87, SSE, segment registers, port I/O, 16-bit addressing or far transfers.
+DecodeStatus decode(const uint8_t* code, size_t available, uint32_t address, Instruction& out);
+
+} // namespace symbolize
@@ -0,0 +1,68 @@
+#include "elf_input.h"
+
+#include <elf.h>
+
+#include <cstring>
+#include <utility>
+
+#include "error.h"
+#include "flash_input.h"
+
+namespace symbolize {
+
+Image load_elf(const std::string& path)
+{
+    return load_elf(MappedFile(path), path);
+}
+
+Image load_elf(MappedFile file, const std::string& path)
+{
+    Image image;
+    image.file = std::move(file);
+    const uint8_t* bytes = image.file.data();
+    const size_t size = image.file.size();
+
+    // Only the page holding the headers is faulted in here; the segment
+    // contents are read later, by whoever needs them.
+    if (size < sizeof(Elf32_Ehdr) || std::memcmp(bytes, ELFMAG, SELFMAG) != 0)
+        throw Error(path + ": not an ELF file");
+    const auto& ehdr = *reinterpret_cast<const Elf32_Ehdr*>(bytes);
+    if (ehdr.e_ident[EI_CLASS] != ELFCLASS32 || ehdr.e_ident[EI_DATA] != ELFDATA2LSB)
+        throw Error(path + ": not a little-endian ELF32 file");
+    if (ehdr.e_type != ET_EXEC)
+        throw Error(path + ": not an ET_EXEC file");
+    if (ehdr.e_machine != EM_IAMCU && ehdr.e_machine != EM_386)
+        throw Error(path + ": unsupported machine " + std::to_string(ehdr.e_machine));
+    if (ehdr.e_phentsize != sizeof(Elf32_Phdr) || ehdr.e_phoff % alignof(Elf32_Phdr) != 0
+        || ehdr.e_phoff + size_t(ehdr.e_phnum) * sizeof(Elf32_Phdr) > size)
+        throw Error(path + ": malformed program header table");
+
+    image.entry = ehdr.e_entry;
+    image.machine = ehdr.e_machine;
+    image.program_headers = {reinterpret_cast<const Elf32_Phdr*>(bytes + ehdr.e_phoff), ehdr.e_phnum};
+    for (const Elf32_Phdr& phdr : image.program_headers) {
+        if (phdr.p_type != PT_LOAD)
+            continue;
+        if (size_t(phdr.p_offset) + phdr.p_filesz > size || phdr.p_filesz > phdr.p_memsz)
+            throw Error(path + ": PT_LOAD outside of the file");
+
+        Segment seg;
+        seg.vaddr = phdr.p_vaddr;
+        seg.paddr = phdr.p_paddr;
+        seg.memsz = phdr.p_memsz;
+        seg.flags = phdr.p_flags;
+        seg.data = Span<uint8_t>(bytes + phdr.p_offset, phdr.p_filesz);
+        image.segments.push_back(seg);
+    }
+    return image;
+}
+
+Image load_input(const std::string& path)
+{
+    MappedFile file(path);
+    if (file.size() >= SELFMAG && std::memcmp(file.data(), ELFMAG, SELFMAG) == 0)
+        return load_elf(std::move(file), path);
+    return load_flash_image(std::move(file));
+}
+
+} // namespace symbolize
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+#include "image.h"
+
+namespace symbolize {
+
+// Loads a stripped ET_EXEC for EM_IAMCU/EM_386. Only program headers are used.
+Image load_elf(const std::string& path);
+Image load_elf(MappedFile file, const std::string& path);
+
+// Loads an ET_EXEC, or a raw flash image when the file has no ELF header.
+Image load_input(const std::string& path);
+
+} // namespace symbolize
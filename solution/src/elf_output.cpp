@@ -0,0 +1,630 @@
+#include "elf_output.h"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <map>
+
+#include "error.h"
+
+namespace symbolize {
+
+namespace {
+
+// Sections never ask for more: a function whose size changes then shifts the
+// following ones by at most this much padding.
+constexpr uint32_t kMaxSectionAlign = 16;
+// picolibc.ld aligns the end of the code to 8 before the constructor lists.
+constexpr uint32_t kTextEndAlign = 8;
+// What objcopy -O binary --gap-fill puts between output sections.
+constexpr uint8_t kFlashGapFill = 0x90;
+// Largest alignment a gap between output sections is read as.
+constexpr uint32_t kMaxGapAlign = 4096;
+constexpr char kGotSymbol[] = "_GLOBAL_OFFSET_TABLE_";
+constexpr char kEntrySymbol[] = "_start";
+
+uint32_t read32(const uint8_t* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+void write32(uint8_t* p, uint32_t value)
+{
+    std::memcpy(p, &value, 4);
+}
+
+uint32_t align_up(uint32_t value, uint32_t align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+// Largest power of two up to `cap` that `addr` is a multiple of.
+uint32_t natural_alignment(uint32_t addr, uint32_t cap)
+{
+    uint32_t align = 1;
+    while (align < cap && addr % (align * 2) == 0)
+        align *= 2;
+    return align;
+}
+
+class StringTable {
+public:
+    StringTable() : bytes_(1, '\0') {}
+
+    uint32_t add(const std::string& s)
+    {
+        const uint32_t offset = uint32_t(bytes_.size());
+        bytes_ += s;
+        bytes_ += '\0';
+        return offset;
+    }
+
+    const std::string& bytes() const { return bytes_; }
+
+private:
+    std::string bytes_;
+};
+
+struct Section {
+    Elf32_Shdr header{};
+    const void* data = nullptr; // file contents, null for SHT_NOBITS and the null section
+};
+
+// Where a local symbol points: an object (by index) or an absolute address.
+struct SymbolInfo {
+    int object = -1;
+    bool placed = false;
+    uint32_t index = 0;
+};
+
+class Writer {
+public:
+    Writer(const Image& image, const Symbolization& result) : image_(image), result_(result) {}
+
+    // Computes the whole file: sections, symbols, relocations and layout.
+    void build();
+    void emit(const std::string& path) const;
+    std::vector<uint8_t> render() const;
+
+private:
+    void copy_segments();
+    void add_object_sections();
+    void restore_flash_gap(uint32_t boundary, uint32_t min_align, bool align_next);
+    void add_symbols();
+    void add_relocations();
+    void add_tables();
+    void lay_out();
+    std::vector<iovec> pieces() const;
+
+    uint8_t* patched(uint32_t addr, uint32_t size);
+    const Object* nearest_object(uint32_t addr) const;
+    uint32_t symbol_address(uint32_t target) const;
+    uint32_t symbol_index(uint32_t addr) const { return symbols_.at(addr).index; }
+    void note_exact_symbol(uint32_t addr);
+    std::string object_prefix(const Object& obj) const;
+    char type_char(const Object& obj) const;
+    std::string symbol_name(uint32_t addr, char type) const;
+
+    const Image& image_;
+    const Symbolization& result_;
+
+    // Copies of the file-backed segments with the relocation fields patched.
+    std::vector<std::pair<const Segment*, std::vector<uint8_t>>> segments_;
+    uint32_t rodata_start_ = UINT32_MAX;
+    uint32_t data_align_cap_ = kMaxSectionAlign;
+    std::vector<uint32_t> sizes_;  // section sizes, objects without trailing gaps
+    std::vector<uint32_t> aligns_; // section alignments
+
+    std::vector<Section> sections_;
+    std::vector<uint32_t> object_section_;
+    StringTable shstrtab_;
+    StringTable strtab_;
+    std::map<uint32_t, SymbolInfo> symbols_; // by address
+    std::vector<Elf32_Sym> symtab_;
+    uint32_t first_global_ = 0;
+    uint32_t got_symbol_ = 0;
+    std::vector<std::vector<Elf32_Rel>> rels_;
+    Elf32_Ehdr ehdr_{};
+    std::vector<Elf32_Shdr> headers_;
+};
+
+void Writer::build()
+{
+    copy_segments();
+    add_object_sections();
+    add_symbols();
+    add_relocations();
+    add_tables();
+    lay_out();
+}
+
+void Writer::copy_segments()
+{
+    for (const Segment& seg : image_.segments)
+        if (seg.filesz())
+            segments_.emplace_back(&seg, std::vector<uint8_t>(seg.data.begin(), seg.data.end()));
+}
+
+uint8_t* Writer::patched(uint32_t addr, uint32_t size)
+{
+    for (auto& [seg, bytes] : segments_)
+        if (addr - seg->vaddr < seg->filesz() && size <= seg->filesz() - (addr - seg->vaddr))
+            return bytes.data() + (addr - seg->vaddr);
+    char buf[64];
+    std::snprintf(buf, sizeof buf, "no file bytes at 0x%08x", addr);
+    throw Error(buf);
+}
+
+std::string Writer::object_prefix(const Object& obj) const
+{
+    switch (obj.kind) {
+    case ObjectKind::Function: return ".text.";
+    case ObjectKind::ReadOnly: return obj.addr < rodata_start_ ? ".text." : ".rodata.";
+    case ObjectKind::Data: return ".data.";
+    case ObjectKind::Bss: return ".bss.";
+    }
+    return ".text.";
+}
+
+char Writer::type_char(const Object& obj) const
+{
+    switch (obj.kind) {
+    case ObjectKind::Function: return 'f';
+    case ObjectKind::ReadOnly: return obj.addr < rodata_start_ ? 't' : 'r';
+    case ObjectKind::Data: return 'd';
+    case ObjectKind::Bss: return 'b';
+    }
+    return 't';
+}
+
+std::string Writer::symbol_name(uint32_t addr, char type) const
+{
+    char buf[16];
+    std::snprintf(buf, sizeof buf, "x%08x%c", addr, type);
+    return buf;
+}
+
+void Writer::add_object_sections()
+{
+    const std::vector<Object>& objects = result_.objects;
+    const Segment* text = image_.text_segment();
+    const uint32_t text_end = text ? text->vaddr + text->filesz() : 0;
+
+    // Everything in .text.* precedes everything in .rodata.*, so data only
+    // moves to .rodata after the last function, and only from an address
+    // the ALIGN(8) closing .text leaves in place.
+    uint32_t last_function = 0;
+    for (const Object& obj : objects)
+        if (obj.kind == ObjectKind::Function)
+            last_function = obj.addr;
+    // In a flash image, fill right after the code is the gap to .rodata.
+    const auto is_gap_fill = [&](const Object& obj) {
+        const uint8_t* bytes = patched(obj.addr, obj.size);
+        return image_.flash_image && std::all_of(bytes, bytes + obj.size, [](uint8_t b) { return b == kFlashGapFill; });
+    };
+    for (const Object& obj : objects) {
+        if (obj.kind == ObjectKind::ReadOnly && obj.addr > last_function && obj.addr % kTextEndAlign == 0
+            && !is_gap_fill(obj)) {
+            rodata_start_ = obj.addr;
+            break;
+        }
+    }
+
+    // .data is ALIGN_WITH_INPUT: its load address in flash follows the code
+    // aligned like the sections in it, so they must not ask for more than
+    // the original did.
+    for (const Segment& seg : image_.segments) {
+        if (!seg.writable() || !seg.filesz() || seg.paddr == seg.vaddr || seg.paddr < text_end)
+            continue;
+        while (data_align_cap_ > 1
+               && (seg.vaddr % data_align_cap_ || align_up(text_end, data_align_cap_) != seg.paddr))
+            data_align_cap_ /= 2;
+    }
+
+    sizes_.reserve(objects.size());
+    aligns_.reserve(objects.size());
+    for (const Object& obj : objects) {
+        sizes_.push_back(obj.size);
+        aligns_.push_back(natural_alignment(obj.addr, obj.kind == ObjectKind::Data ? data_align_cap_ : kMaxSectionAlign));
+    }
+    if (image_.flash_image) {
+        restore_flash_gap(rodata_start_, kTextEndAlign, true);
+        restore_flash_gap(result_.got, 1, false);
+    }
+
+    sections_.emplace_back();
+    object_section_.reserve(objects.size());
+    for (size_t i = 0; i < objects.size(); ++i) {
+        const Object& obj = objects[i];
+        Section sec;
+        Elf32_Shdr& sh = sec.header;
+        sh.sh_name = shstrtab_.add(object_prefix(obj) + symbol_name(obj.addr, type_char(obj)));
+        sh.sh_type = obj.kind == ObjectKind::Bss ? SHT_NOBITS : SHT_PROGBITS;
+        sh.sh_flags = SHF_ALLOC;
+        if (obj.kind == ObjectKind::Function || (obj.kind == ObjectKind::ReadOnly && obj.addr < rodata_start_))
+            sh.sh_flags |= SHF_EXECINSTR;
+        if (obj.kind == ObjectKind::Data || obj.kind == ObjectKind::Bss)
+            sh.sh_flags |= SHF_WRITE;
+        // Not used by the linker, but it tells readers where the object was.
+        sh.sh_addr = obj.addr;
+        sh.sh_size = sizes_[i];
+        sh.sh_addralign = aligns_[i];
+        if (obj.kind != ObjectKind::Bss)
+            sec.data = patched(obj.addr, sizes_[i]);
+        object_section_.push_back(uint32_t(sections_.size()));
+        sections_.push_back(sec);
+    }
+    if (sections_.size() >= SHN_LORESERVE)
+        throw Error("too many objects for one ELF file");
+}
+
+// A flash image has 0x90 fill between output sections where the executable
+// had zeros. The fill in front of `boundary` is left out of the object before
+// it, for the linker to recreate: from the alignment of the next section, or
+// from the `min_align` the linker script gives the output section there.
+void Writer::restore_flash_gap(uint32_t boundary, uint32_t min_align, bool align_next)
+{
+    const Object* prev = boundary ? result_.object_at(boundary - 1) : nullptr;
+    if (!prev || prev->end() != boundary || prev->kind == ObjectKind::Bss)
+        return;
+    const uint8_t* bytes = patched(prev->addr, prev->size);
+    uint32_t begin = boundary;
+    // Only a function keeps a byte; data that is all fill was the gap.
+    const uint32_t first = prev->addr + (prev->kind == ObjectKind::Function);
+    while (begin > first && bytes[begin - 1 - prev->addr] == kFlashGapFill)
+        --begin;
+    // Fill before the ALIGN() closing the previous output section is its own.
+    begin = std::min(align_up(begin, min_align), boundary);
+    if (begin == boundary)
+        return;
+
+    uint32_t align = 1;
+    while (align < kMaxGapAlign && align_up(begin, align) != boundary)
+        align *= 2;
+    if (align_up(begin, align) != boundary)
+        return;
+    const size_t next = prev - result_.objects.data() + 1;
+    if (align_next && next < aligns_.size())
+        aligns_[next] = std::max(aligns_[next], align);
+    else if (!align_next && align > min_align)
+        return;
+    sizes_[prev - result_.objects.data()] = begin - prev->addr;
+}
+
+const Object* Writer::nearest_object(uint32_t addr) const
+{
+    if (const Object* obj = result_.object_at(addr))
+        return obj;
+    // End pointers (the stack top, the end of .bss) belong to the last object
+    // before them in the same memory window.
+    const auto same_window = [](uint32_t a, uint32_t b) {
+        return (a - kFlashOrigin < kFlashSize && b - kFlashOrigin <= kFlashSize)
+               || (a - kRamOrigin < kRamSize && b - kRamOrigin <= kRamSize);
+    };
+    const Object* best = nullptr;
+    for (const Object& obj : result_.objects)
+        if (obj.addr <= addr && same_window(obj.addr, addr))
+            best = &obj;
+    return best;
+}
+
+// The symbol a relocation to `target` is expressed against: the object it
+// falls in, with the rest folded into the addend.
+uint32_t Writer::symbol_address(uint32_t target) const
+{
+    const Object* obj = nearest_object(target);
+    return obj ? obj->addr : target;
+}
+
+// GOT entries hold the exact address of their symbol.
+void Writer::note_exact_symbol(uint32_t addr)
+{
+    if (symbols_.count(addr))
+        return;
+    const Object* obj = result_.object_at(addr);
+    symbols_[addr].object = obj ? int(obj - result_.objects.data()) : -1;
+}
+
+void Writer::add_symbols()
+{
+    const std::vector<Object>& objects = result_.objects;
+    for (size_t i = 0; i < objects.size(); ++i)
+        symbols_[objects[i].addr].object = int(i);
+
+    std::map<uint32_t, uint32_t> got_slots; // slot -> value
+    for (const Relocation& rel : result_.relocations) {
+        if (rel.type == R_386_GOT32)
+            got_slots.emplace(rel.target, read32(patched(rel.target, 4)));
+        else if (rel.type != R_386_GOTPC)
+            note_exact_symbol(symbol_address(rel.target));
+    }
+    for (const auto& [slot, value] : got_slots)
+        note_exact_symbol(value);
+
+    // ld allocates the GOT entries of local symbols in symbol table order, so
+    // the symbols behind GOT slots come first, in slot order.
+    symtab_.emplace_back();
+    const auto place = [&](uint32_t addr) {
+        SymbolInfo& info = symbols_.at(addr);
+        if (info.placed)
+            return;
+        info.placed = true;
+        info.index = uint32_t(symtab_.size());
+
+        Elf32_Sym sym{};
+        if (info.object < 0) {
+            sym.st_name = strtab_.add(symbol_name(addr, 'a'));
+            sym.st_value = addr;
+            sym.st_info = ELF32_ST_INFO(STB_LOCAL, STT_NOTYPE);
+            sym.st_shndx = SHN_ABS;
+        } else {
+            const Object& obj = objects[info.object];
+            sym.st_name = strtab_.add(symbol_name(addr, type_char(obj)));
+            sym.st_value = addr - obj.addr;
+            sym.st_info = ELF32_ST_INFO(STB_LOCAL, obj.kind == ObjectKind::Function ? STT_FUNC : STT_OBJECT);
+            sym.st_shndx = uint16_t(object_section_[info.object]);
+            if (addr == obj.addr)
+                sym.st_size = sizes_[info.object];
+        }
+        symtab_.push_back(sym);
+    };
+    for (const auto& [slot, value] : got_slots)
+        place(value);
+    for (const auto& [addr, info] : symbols_)
+        place(addr);
+
+    first_global_ = uint32_t(symtab_.size());
+    if (const Object* entry = result_.object_at(image_.entry)) {
+        Elf32_Sym sym{};
+        sym.st_name = strtab_.add(kEntrySymbol);
+        sym.st_value = image_.entry - entry->addr;
+        sym.st_info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC);
+        sym.st_shndx = uint16_t(object_section_[entry - objects.data()]);
+        symtab_.push_back(sym);
+    }
+    if (result_.got) {
+        Elf32_Sym sym{};
+        sym.st_name = strtab_.add(kGotSymbol);
+        sym.st_info = ELF32_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+        sym.st_shndx = SHN_UNDEF;
+        got_symbol_ = uint32_t(symtab_.size());
+        symtab_.push_back(sym);
+    }
+}
+
+void Writer::add_relocations()
+{
+    const std::vector<Object>& objects = result_.objects;
+    rels_.assign(objects.size(), {});
+    const uint32_t got = result_.got;
+
+    for (const Relocation& rel : result_.relocations) {
+        const Object* obj = result_.object_at(rel.site);
+        if (!obj)
+            continue;
+        uint8_t* field = patched(rel.site, 4);
+        const uint32_t value = read32(field);
+        const uint32_t site = rel.site;
+
+        // The addend stays in the field (REL): rewrite it so the linker
+        // computes the original value again.
+        uint32_t sym_index = 0;
+        uint32_t addend = 0;
+        if (rel.type == R_386_GOTPC) {
+            if (!got_symbol_)
+                continue;
+            sym_index = got_symbol_;
+            addend = value - got + site;
+        } else if (rel.type == R_386_GOT32) {
+            sym_index = symbol_index(read32(patched(rel.target, 4)));
+            addend = value - (rel.target - got);
+        } else {
+            const uint32_t s = symbol_address(rel.target);
+            sym_index = symbol_index(s);
+            switch (rel.type) {
+            case R_386_PC32: addend = value - s + site; break;
+            case R_386_GOTOFF: addend = value - s + got; break;
+            default: addend = value - s; break;
+            }
+        }
+        write32(field, addend);
+
+        Elf32_Rel entry;
+        entry.r_offset = site - obj->addr;
+        entry.r_info = ELF32_R_INFO(sym_index, rel.type);
+        rels_[obj - objects.data()].push_back(entry);
+    }
+
+    for (size_t i = 0; i < objects.size(); ++i) {
+        if (rels_[i].empty())
+            continue;
+        const Elf32_Shdr& target = sections_[object_section_[i]].header;
+        Section sec;
+        Elf32_Shdr& sh = sec.header;
+        sh.sh_name = shstrtab_.add(".rel" + std::string(shstrtab_.bytes().c_str() + target.sh_name));
+        sh.sh_type = SHT_REL;
+        sh.sh_flags = SHF_INFO_LINK;
+        sh.sh_size = uint32_t(rels_[i].size() * sizeof(Elf32_Rel));
+        sh.sh_info = object_section_[i];
+        sh.sh_addralign = 4;
+        sh.sh_entsize = sizeof(Elf32_Rel);
+        sec.data = rels_[i].data();
+        sections_.push_back(sec);
+    }
+}
+
+void Writer::add_tables()
+{
+    const uint32_t symtab_index = uint32_t(sections_.size());
+    for (Section& sec : sections_)
+        if (sec.header.sh_type == SHT_REL)
+            sec.header.sh_link = symtab_index;
+
+    Section symtab;
+    symtab.header.sh_name = shstrtab_.add(".symtab");
+    symtab.header.sh_type = SHT_SYMTAB;
+    symtab.header.sh_size = uint32_t(symtab_.size() * sizeof(Elf32_Sym));
+    symtab.header.sh_link = symtab_index + 1;
+    symtab.header.sh_info = first_global_;
+    symtab.header.sh_addralign = 4;
+    symtab.header.sh_entsize = sizeof(Elf32_Sym);
+    symtab.data = symtab_.data();
+    sections_.push_back(symtab);
+
+    Section strtab;
+    strtab.header.sh_name = shstrtab_.add(".strtab");
+    strtab.header.sh_type = SHT_STRTAB;
+    strtab.header.sh_size = uint32_t(strtab_.bytes().size());
+    strtab.header.sh_addralign = 1;
+    strtab.data = strtab_.bytes().data();
+    sections_.push_back(strtab);
+
+    // The last name added: the table is complete once it is in.
+    Section shstrtab;
+    shstrtab.header.sh_name = shstrtab_.add(".shstrtab");
+    shstrtab.header.sh_type = SHT_STRTAB;
+    shstrtab.header.sh_size = uint32_t(shstrtab_.bytes().size());
+    shstrtab.header.sh_addralign = 1;
+    shstrtab.data = shstrtab_.bytes().data();
+    sections_.push_back(shstrtab);
+}
+
+void Writer::lay_out()
+{
+    uint32_t offset = sizeof(Elf32_Ehdr);
+    for (Section& sec : sections_) {
+        Elf32_Shdr& sh = sec.header;
+        if (sh.sh_type == SHT_NULL)
+            continue;
+        // Object contents are packed back to back, like in the image; the
+        // tables keep their natural alignment.
+        if (sh.sh_type != SHT_PROGBITS && sh.sh_type != SHT_NOBITS)
+            offset = align_up(offset, sh.sh_addralign);
+        sh.sh_offset = offset;
+        if (sh.sh_type != SHT_NOBITS)
+            offset += sh.sh_size;
+    }
+
+    std::memcpy(ehdr_.e_ident, ELFMAG, SELFMAG);
+    ehdr_.e_ident[EI_CLASS] = ELFCLASS32;
+    ehdr_.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr_.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr_.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    ehdr_.e_type = ET_REL;
+    ehdr_.e_machine = image_.machine;
+    ehdr_.e_version = EV_CURRENT;
+    ehdr_.e_shoff = align_up(offset, 4);
+    ehdr_.e_ehsize = sizeof(Elf32_Ehdr);
+    ehdr_.e_shentsize = sizeof(Elf32_Shdr);
+    ehdr_.e_shnum = uint16_t(sections_.size());
+    ehdr_.e_shstrndx = uint16_t(sections_.size() - 1);
+
+    headers_.reserve(sections_.size());
+    for (const Section& sec : sections_)
+        headers_.push_back(sec.header);
+}
+
+std::vector<iovec> Writer::pieces() const
+{
+    static const uint8_t zeros[4] = {};
+
+    // One iovec per run of contiguous bytes: the objects of a segment are
+    // adjacent in its patched copy and go out as one piece.
+    std::vector<iovec> iov;
+    uint32_t offset = 0;
+    const auto append = [&](const void* data, size_t size) {
+        if (!size)
+            return;
+        if (!iov.empty() && static_cast<const uint8_t*>(iov.back().iov_base) + iov.back().iov_len == data)
+            iov.back().iov_len += size;
+        else
+            iov.push_back({const_cast<void*>(data), size});
+        offset += uint32_t(size);
+    };
+    append(&ehdr_, sizeof ehdr_);
+    for (const Section& sec : sections_) {
+        if (!sec.data)
+            continue;
+        append(zeros, sec.header.sh_offset - offset);
+        append(sec.data, sec.header.sh_size);
+    }
+    append(zeros, ehdr_.e_shoff - offset);
+    append(headers_.data(), headers_.size() * sizeof(Elf32_Shdr));
+    return iov;
+}
+
+// Writes `iov` to `path` in as few writev calls as IOV_MAX allows.
+void write_pieces(const std::string& path, std::vector<iovec> iov)
+{
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw Error("cannot create " + path + ": " + std::strerror(errno));
+    size_t next = 0;
+    while (next < iov.size()) {
+        const int count = int(std::min<size_t>(iov.size() - next, IOV_MAX));
+        ssize_t written = ::writev(fd, iov.data() + next, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            const int err = errno;
+            ::close(fd);
+            throw Error("cannot write " + path + ": " + std::strerror(err));
+        }
+        // Skip what went out; a short write resumes mid-iovec.
+        while (next < iov.size() && size_t(written) >= iov[next].iov_len)
+            written -= ssize_t(iov[next++].iov_len);
+        if (written) {
+            iov[next].iov_base = static_cast<uint8_t*>(iov[next].iov_base) + written;
+            iov[next].iov_len -= size_t(written);
+        }
+    }
+    if (::close(fd) != 0)
+        throw Error("cannot write " + path + ": " + std::strerror(errno));
+}
+
+void Writer::emit(const std::string& path) const
+{
+    write_pieces(path, pieces());
+}
+
+std::vector<uint8_t> Writer::render() const
+{
+    std::vector<uint8_t> out;
+    for (const iovec& piece : pieces()) {
+        const uint8_t* data = static_cast<const uint8_t*>(piece.iov_base);
+        out.insert(out.end(), data, data + piece.iov_len);
+    }
+    return out;
+}
+
+} // namespace
+
+void write_relocatable(const std::string& path, const Image& image, const Symbolization& result)
+{
+    Writer writer(image, result);
+    writer.build();
+    writer.emit(path);
+}
+
+std::vector<uint8_t> relocatable_bytes(const Image& image, const Symbolization& result)
+{
+    Writer writer(image, result);
+    writer.build();
+    return writer.render();
+}
+
+void write_relocatable(const std::string& path, const std::vector<uint8_t>& bytes)
+{
+    write_pieces(path, {{const_cast<uint8_t*>(bytes.data()), bytes.size()}});
+}
+
+} // namespace symbolize
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "image.h"
+#include "symbolization.h"
+
+namespace symbolize {
+
+// Writes the recovered objects of `image` as an ET_REL: one section and one
+// local symbol x<addr><type> per object, a SHT_REL section per object with
+// relocations, the symbol and string tables. The whole layout is computed
+// first and the file is then written sequentially with writev.
+void write_relocatable(const std::string& path, const Image& image, const Symbolization& result);
+
+// The same file as write_relocatable, in memory; the second overload writes
+// it out.
+std::vector<uint8_t> relocatable_bytes(const Image& image, const Symbolization& result);
+void write_relocatable(const std::string& path, const std::vector<uint8_t>& bytes);
+
+} // namespace symbolize
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+namespace symbolize {
+
+// Every unrecoverable problem with the input or the environment.
+// Caught once in main() and reported as "symbolize: <what>".
+class Error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+} // namespace symbolize
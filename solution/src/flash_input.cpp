@@ -0,0 +1,202 @@
+#include "flash_input.h"
+
+#include <elf.h>
+
+#include <algorithm>
+#include <set>
+
+#include "byte_runs.h"
+#include "cfg.h"
+#include "error.h"
+#include "heuristics.h"
+#include "superset.h"
+#include "validity.h"
+
+namespace symbolize {
+
+namespace {
+
+constexpr uint8_t kGapFill = 0x90;
+// A fill longer than this is not alignment padding in front of .data.
+constexpr uint32_t kMaxDataAlign = 16;
+// .data ends with ALIGN(8) in picolibc.ld.
+constexpr uint32_t kDataSizeAlign = 8;
+constexpr uint32_t kTextEndAlign = 8;
+constexpr uint32_t kGotPltSize = 12;
+
+bool is_printable(uint8_t c)
+{
+    return (c >= 0x20 && c < 0x7F) || c == '\t' || c == '\n' || c == '\r' || c >= 0x80;
+}
+
+// How far a reference to `offset` is known to extend: a whole C string, or
+// a word.
+uint32_t referenced_extent(const uint8_t* bytes, uint32_t size, uint32_t offset)
+{
+    uint32_t end = offset;
+    while (end < size && is_printable(bytes[end]))
+        ++end;
+    if (end > offset && end < size && bytes[end] == 0)
+        return end + 1 - offset;
+    return std::min<uint32_t>(4, size - offset);
+}
+
+// Picks the .data size among multiples of 8 that leave the known code and
+// read-only data in the text segment. Evidence for a split, in order of
+// weight: .bss (a referenced RAM address) starts right after it, the text
+// then ends where the references say it does, a short 0x90 fill aligns
+// the load image, nothing in RAM is referenced past it.
+FlashLayout choose_layout(const uint8_t* bytes, uint32_t size, uint32_t text_min, const std::set<uint32_t>& ram_refs)
+{
+    const std::vector<ByteRun> fills = find_byte_runs(bytes, size, kGapFill);
+    const auto fill_before = [&](uint32_t offset) -> uint32_t {
+        auto it = std::lower_bound(fills.begin(), fills.end(), offset,
+                                   [](const ByteRun& run, uint32_t o) { return run.end < o; });
+        return it != fills.end() && it->end == offset ? it->size() : 0;
+    };
+
+    FlashLayout best{size, size, 0};
+    int best_score = -1;
+    for (uint32_t data_size = 0; data_size <= size - text_min; data_size += kDataSizeAlign) {
+        const uint32_t lma = size - data_size;
+        uint32_t gap = 0;
+        if (data_size) {
+            // The fill must be shorter than an alignment the load address has.
+            const uint32_t fill = fill_before(lma);
+            uint32_t align = 1;
+            while (align < kMaxDataAlign && lma % (align * 2) == 0)
+                align *= 2;
+            // .text ends with ALIGN(8), padded with nops: a shorter run in
+            // front of an 8-aligned address is the end of the code.
+            if (fill && fill < align && (align < kTextEndAlign || fill >= kTextEndAlign))
+                gap = std::min(fill, lma - text_min);
+        }
+        const uint32_t text_size = lma - gap;
+        const uint32_t bss_start = kRamOrigin + data_size;
+
+        int score = 0;
+        if (data_size && ram_refs.count(bss_start))
+            score += 4;
+        if (text_size - text_min < 4)
+            score += 2;
+        if (gap)
+            score += 2;
+        if (ram_refs.empty() || *ram_refs.rbegin() < bss_start)
+            score += 1;
+        if (score >= best_score) {
+            best_score = score;
+            best = {text_size, lma, data_size};
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+Image load_flash_image(MappedFile file)
+{
+    if (file.size() == 0)
+        throw Error("empty flash image");
+
+    // Empty sections at RAM addresses stretch the image up to the RAM window
+    // with fill: only the flash window counts, up to the fill ending it.
+    uint32_t size = uint32_t(std::min<size_t>(file.size(), kFlashSize));
+    if (file.size() > kFlashSize) {
+        const std::vector<ByteRun> fills = find_byte_runs(file.data(), size, kGapFill);
+        if (fills.empty() || fills.back().end != size)
+            throw Error("flash image larger than the flash window");
+        size = fills.back().begin;
+    }
+
+    Image image;
+    image.file = std::move(file);
+    image.flash_image = true;
+    image.entry = kFlashOrigin;
+    image.machine = EM_386;
+
+    Segment text;
+    text.vaddr = text.paddr = kFlashOrigin;
+    text.memsz = size;
+    text.flags = PF_R | PF_X;
+    text.data = Span<uint8_t>(image.file.data(), size);
+    image.segments.push_back(text);
+    return image;
+}
+
+FlashLayout split_flash_image(Image& image, unsigned threads)
+{
+    const Segment whole = image.segments.at(0);
+    const uint8_t* bytes = whole.data.data();
+    const uint32_t size = whole.filesz();
+
+    // Everything the code reaches or references stays in the text segment.
+    uint32_t text_min = 0;
+    std::set<uint32_t> ram_refs;
+    {
+        SupersetTable table = build_superset(whole, threads);
+        Arena scratch;
+        Bitset is_instr = compute_is_instr(table, scratch);
+        const Cfg cfg = build_cfg(table, is_instr, scratch);
+        Heuristics heuristics(image, table, is_instr, cfg, nullptr, threads);
+        Symbolization result = heuristics.run();
+
+        for (size_t r = 0; r < heuristics.code.size(); ++r) {
+            const uint32_t offset = heuristics.code.at(r, 0) - whole.vaddr;
+            text_min = std::max(text_min, offset + table.length[offset]);
+        }
+        if (result.got)
+            text_min = std::max(text_min, result.got + kGotPltSize - whole.vaddr);
+        for (const Relocation& rel : result.relocations) {
+            if (rel.type == R_386_GOT32)
+                text_min = std::max(text_min, rel.target + 4 - whole.vaddr);
+            if (rel.target - kRamOrigin < kRamSize)
+                ram_refs.insert(rel.target);
+        }
+        // References from the text (sorted by site) pull what they point at
+        // in; data referenced by that data follows.
+        for (const Relocation& rel : result.relocations) {
+            if (rel.site - whole.vaddr >= text_min)
+                break;
+            const uint32_t target = rel.target - whole.vaddr;
+            if ((rel.type == R_386_32 || rel.type == R_386_GOTOFF) && target < size)
+                text_min = std::max(text_min, target + referenced_extent(bytes, size, target));
+        }
+        text_min = std::min(text_min, size);
+    }
+
+    const FlashLayout layout = choose_layout(bytes, size, text_min, ram_refs);
+    apply_flash_layout(image, layout);
+    return layout;
+}
+
+void apply_flash_layout(Image& image, const FlashLayout& layout)
+{
+    const Segment whole = image.segments.at(0);
+    const uint32_t size = whole.filesz();
+    if (layout.text_size > size || layout.data_offset > size || layout.data_size > size - layout.data_offset
+        || layout.data_size > kRamSize)
+        throw Error("flash layout outside of the image");
+
+    Segment text = whole;
+    text.memsz = layout.text_size;
+    text.data = Span<uint8_t>(whole.data.data(), layout.text_size);
+    image.segments.assign(1, text);
+
+    // The order of the PHDRS in picolibc.ld: text, ram, ram_init.
+    Segment bss;
+    bss.vaddr = bss.paddr = kRamOrigin + layout.data_size;
+    bss.memsz = kRamOrigin + kRamSize - bss.vaddr;
+    bss.flags = PF_R | PF_W;
+    image.segments.push_back(bss);
+    if (layout.data_size) {
+        Segment data;
+        data.vaddr = kRamOrigin;
+        data.paddr = whole.vaddr + layout.data_offset;
+        data.memsz = layout.data_size;
+        data.flags = PF_R | PF_W;
+        data.data = Span<uint8_t>(whole.data.data() + layout.data_offset, layout.data_size);
+        image.segments.push_back(data);
+    }
+}
+
+} // namespace symbolize
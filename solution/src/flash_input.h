@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+#include "image.h"
+#include "parallel.h"
+
+namespace symbolize {
+
+// Where the parts of a raw flash image (`objcopy -O binary --gap-fill 0x90`)
+// are, as offsets from kFlashOrigin: the code segment, the 0x90 fill that
+// aligns the .data load image, and that image (copied to kRamOrigin).
+struct FlashLayout {
+    uint32_t text_size = 0;
+    uint32_t data_offset = 0;
+    uint32_t data_size = 0;
+};
+
+// Wraps a flash image as a provisional Image: one executable segment at
+// kFlashOrigin holding all of it, entry point at its start.
+Image load_flash_image(MappedFile file);
+
+// Finds the end of the code segment and the .data load image by analysing
+// the whole image as code first, then replaces the provisional segment with
+// the text, .data and .bss segments the linker script would have produced.
+FlashLayout split_flash_image(Image& image, unsigned threads = worker_count());
+
+// Replaces the provisional segment with the ones `layout` describes.
+void apply_flash_layout(Image& image, const FlashLayout& layout);
+
+} // namespace symbolize
@@ -0,0 +1,79 @@
+#include "function_cache.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+
+#include "error.h"
+#include "result_cache.h"
+
+namespace symbolize {
+
+namespace {
+
+SignatureDb load_or_empty(const std::string& path)
+{
+    if (access(path.c_str(), R_OK) != 0)
+        return {};
+    try {
+        return SignatureDb::load(path);
+    } catch (const Error&) {
+        return {};
+    }
+}
+
+// The input an entry was recovered from.
+std::string source_of(const Signature& sig)
+{
+    const size_t bar = sig.name.rfind('|');
+    return bar == std::string::npos ? std::string() : sig.name.substr(0, bar);
+}
+
+} // namespace
+
+FunctionCache::FunctionCache(const std::string& dir)
+    : path_(dir + "/functions-" + Sha256::hex(tool_digest()).substr(0, 16) + ".db"), known_(load_or_empty(path_))
+{
+}
+
+void FunctionCache::add(const std::string& input, std::vector<Signature> functions)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    inputs_.insert(input);
+    for (Signature& sig : functions) {
+        sig.name = input + "|" + sig.name;
+        pending_.push_back(std::move(sig));
+    }
+}
+
+bool FunctionCache::save()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (inputs_.empty())
+        return true;
+
+    const SignatureDb saved = load_or_empty(path_);
+    SignatureDb merged;
+    for (const Signature& sig : saved.signatures())
+        if (!inputs_.count(source_of(sig)))
+            merged.add(sig);
+    for (Signature& sig : pending_)
+        merged.add(std::move(sig));
+    pending_.clear();
+    inputs_.clear();
+
+    const std::string temp = path_ + "." + std::to_string(getpid());
+    try {
+        merged.save(temp);
+    } catch (const Error&) {
+        unlink(temp.c_str());
+        return false;
+    }
+    if (std::rename(temp.c_str(), path_.c_str()) != 0) {
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace symbolize
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "signatures.h"
+
+namespace symbolize {
+
+// Functions and pointer-holding data recovered from earlier inputs, kept in
+// the cache directory as a signature database of their own (see
+// Heuristics::object_signatures). A new revision of a firmware mostly re-links
+// the same objects at other addresses: where one of them is found again, its
+// extent and relocations are taken over instead of re-derived. Each entry is
+// tagged with the input it was recovered from (`<input>|<name>`), so that
+// inputs of different firmwares share the file. It is named after the
+// symbolize executable (see tool_digest), so a rebuilt tool starts over.
+class FunctionCache {
+public:
+    // Loads what earlier runs saved; a missing or unreadable file is empty.
+    explicit FunctionCache(const std::string& dir);
+
+    // What was loaded; add() does not change it, so workers may search it
+    // while others add.
+    const SignatureDb& known() const { return known_; }
+
+    // The objects recovered from `input`. Thread-safe. Kept for save().
+    void add(const std::string& input, std::vector<Signature> functions);
+
+    // Rewrites the file: the entries of the inputs added by this run are
+    // replaced by what was added, so what this revision no longer holds is
+    // dropped; those of other inputs, including any saved meanwhile, are
+    // kept. False when it cannot be written.
+    bool save();
+
+private:
+    std::string path_;
+    SignatureDb known_;
+    std::mutex mutex_;
+    std::set<std::string> inputs_;
+    std::vector<Signature> pending_;
+};
+
+} // namespace symbolize
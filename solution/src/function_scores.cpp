@@ -0,0 +1,74 @@
+#include "function_scores.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SYMBOLIZE_X86_SIMD 1
+#endif
+
+namespace symbolize {
+
+namespace {
+
+#ifdef SYMBOLIZE_X86_SIMD
+
+// Unsigned a >= t as max(a, t) == a: there is no unsigned byte compare.
+__attribute__((target("avx2"))) size_t at_least_avx2(const uint8_t* score, size_t size, uint8_t threshold,
+                                                     Bitset& out)
+{
+    const __m256i t = _mm256_set1_epi8(char(threshold));
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        uint64_t bits = 0;
+        for (unsigned k = 0; k < 2; ++k) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(score + i + 32 * k));
+            const __m256i ge = _mm256_cmpeq_epi8(_mm256_max_epu8(v, t), v);
+            bits |= uint64_t(uint32_t(_mm256_movemask_epi8(ge))) << (32 * k);
+        }
+        out.words()[i / 64] = bits;
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) size_t at_least_sse2(const uint8_t* score, size_t size, uint8_t threshold,
+                                                     Bitset& out)
+{
+    const __m128i t = _mm_set1_epi8(char(threshold));
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        uint64_t bits = 0;
+        for (unsigned k = 0; k < 4; ++k) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(score + i + 16 * k));
+            const __m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(v, t), v);
+            bits |= uint64_t(uint32_t(_mm_movemask_epi8(ge))) << (16 * k);
+        }
+        out.words()[i / 64] = bits;
+    }
+    return i;
+}
+
+#endif // SYMBOLIZE_X86_SIMD
+
+} // namespace
+
+void FunctionScores::add(const std::vector<uint32_t>& offsets, uint8_t weight)
+{
+    for (uint32_t offset : offsets)
+        if (offset < score_.size())
+            add(offset, weight);
+}
+
+Bitset FunctionScores::at_least(uint8_t threshold) const
+{
+    Bitset out(score_.size());
+    size_t done = 0;
+#ifdef SYMBOLIZE_X86_SIMD
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    done = avx2 ? at_least_avx2(score_.data(), score_.size(), threshold, out)
+                : at_least_sse2(score_.data(), score_.size(), threshold, out);
+#endif
+    for (; done < score_.size(); ++done)
+        out.assign(done, score_[done] >= threshold);
+    return out;
+}
+
+} // namespace symbolize
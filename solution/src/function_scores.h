@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bitset.h"
+
+namespace symbolize {
+
+// Evidence that a function starts at an offset, summed into one saturating
+// byte per offset. Every kind of evidence is scattered into the array in one
+// pass; the starts are then picked with one compare over all offsets rather
+// than by looking at each candidate in turn.
+class FunctionScores {
+public:
+    explicit FunctionScores(size_t size) : score_(size, 0) {}
+
+    size_t size() const { return score_.size(); }
+    uint8_t at(size_t offset) const { return score_[offset]; }
+
+    void add(size_t offset, uint8_t weight)
+    {
+        const unsigned sum = score_[offset] + weight;
+        score_[offset] = uint8_t(sum > 0xFF ? 0xFF : sum);
+    }
+
+    // Scatter-add of `weight` at every offset; offsets out of range are
+    // ignored.
+    void add(const std::vector<uint32_t>& offsets, uint8_t weight);
+
+    // Bit o is set when offset o scores at least `threshold`; 32 (AVX2) or
+    // 16 (SSE2) scores are compared at a time.
+    Bitset at_least(uint8_t threshold) const;
+
+private:
+    std::vector<uint8_t> score_;
+};
+
+} // namespace symbolize
@@ -0,0 +1,1676 @@
+#include "heuristics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <set>
+
+#include "error.h"
+#include "function_scores.h"
+#include "parallel.h"
+
+namespace symbolize {
+
+namespace {
+
+using datalog::Range;
+using datalog::Relation;
+using datalog::RuleContext;
+
+constexpr uint32_t kEbx = 3;
+// ebx, ebp, esi, edi: a function has to save them before it may change them,
+// and has no defined value to read from them before it did.
+constexpr uint8_t kNonArgument = 0xE8;
+constexpr uint32_t kNoRegister = 8;
+// .got.plt: the three reserved words _GLOBAL_OFFSET_TABLE_ points at.
+constexpr uint32_t kGotPltSize = 12;
+// Stack reserved by the unpatched picolibc.ld right after .bss.
+constexpr uint32_t kDefaultStackSize = 0x1000;
+// Instructions a register is traced back over.
+constexpr int kMaxTraceSteps = 64;
+// Longest jump table followed: gcc uses one up to a few thousand cases.
+constexpr uint32_t kMaxTableEntries = 4096;
+// Shortest run of code addresses taken for a table of function pointers.
+constexpr uint32_t kMinPointerRun = 2;
+
+// Evidence of a function start (see score_function_starts) and the score
+// from which it is taken as one: no kind is enough on its own, a call
+// target or a code pointer needs a boundary or a prologue to go with it.
+constexpr uint8_t kCallTarget = 2;     // of a call rel32
+constexpr uint8_t kTailJumpTarget = 1; // of a jmp rel32
+constexpr uint8_t kCodePointer = 2;    // an imm32 or a data word holds the address
+constexpr uint8_t kAfterBoundary = 2;  // after a terminator and its padding
+constexpr uint8_t kAligned = 1;        // padded up to a 4-byte boundary (.align 4)
+constexpr uint8_t kFramePrologue = 3;  // push %ebp; mov %esp,%ebp
+constexpr uint8_t kSavesRegisters = 1; // push of ebx, ebp, esi or edi, not after another
+constexpr uint8_t kGotPrologue = 3;    // pushes, then a call to a PC thunk
+constexpr uint8_t kFunctionScore = 4;
+
+uint32_t read32(const uint8_t* p)
+{
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+// Base register of a memory operand, kNoRegister for absolute or index-only forms.
+uint32_t base_register(const Instruction& insn)
+{
+    if (!insn.has_memory_operand())
+        return kNoRegister;
+    if (insn.has_sib) {
+        const uint8_t base = insn.sib & 7;
+        return insn.mod() == 0 && base == 5 ? kNoRegister : base;
+    }
+    return insn.mod() == 0 && insn.rm() == 5 ? kNoRegister : insn.rm();
+}
+
+bool has_index(const Instruction& insn)
+{
+    return insn.has_sib && ((insn.sib >> 3) & 7) != 4;
+}
+
+// Alignment fillers emitted by gas: nop, xchg %ax,%ax, mov %reg,%reg and
+// lea 0(%reg),%reg in their various lengths.
+bool is_padding(const Instruction& insn)
+{
+    switch (insn.opcode) {
+    case 0x90: return !insn.rep;
+    case 0x11F: return true;
+    case 0x89: case 0x8B: return insn.mod() == 3 && insn.reg() == insn.rm();
+    case 0x8D:
+        return insn.disp == 0 && !has_index(insn) && base_register(insn) == insn.reg() && insn.mod() != 0;
+    default: return false;
+    }
+}
+
+bool saves_register(uint8_t byte)
+{
+    return byte == 0x53 || byte == 0x55 || byte == 0x56 || byte == 0x57;
+}
+
+bool is_frame_setup(const uint8_t* p)
+{
+    return p[0] == 0x55 && ((p[1] == 0x89 && p[2] == 0xE5) || (p[1] == 0x8B && p[2] == 0xEC));
+}
+
+// Walks back from `offset` over the pushes of non-argument registers and
+// the frame set-up a function opens with.
+size_t prologue_start(const uint8_t* code, size_t offset)
+{
+    for (int steps = 0; steps < 5; ++steps) {
+        if (offset >= 3 && is_frame_setup(code + offset - 3))
+            offset -= 3;
+        else if (offset >= 1 && saves_register(code[offset - 1]))
+            offset -= 1;
+        else
+            break;
+    }
+    return offset;
+}
+
+bool is_terminator(Flow flow)
+{
+    return flow == Flow::Return || flow == Flow::Jump || flow == Flow::IndirectJump || flow == Flow::Trap;
+}
+
+bool any_changed(const RuleContext& ctx, std::initializer_list<const datalog::RelationBase*> relations)
+{
+    bool changed = false;
+    for (const datalog::RelationBase* rel : relations)
+        changed |= !ctx.delta(*rel).empty();
+    return changed;
+}
+
+// Calls fn(l, r) for the pairs of rows of `left` and `right` sharing their
+// first column that a rule has not seen: delta(left) joined with all(right),
+// then seen(left) with delta(right), both through the index.
+template <size_t A, size_t B, typename Fn>
+void join(const RuleContext& ctx, const Relation<A>& left, const Relation<B>& right, Fn&& fn)
+{
+    const Range fresh = ctx.delta(left);
+    for (size_t l = fresh.begin; l < fresh.end; ++l)
+        right.for_key(left.at(l, 0), ctx.end(right), [&](size_t r) { fn(l, r); });
+    const Range added = ctx.delta(right);
+    for (size_t r = added.begin; fresh.begin && r < added.end; ++r)
+        left.for_key(right.at(r, 0), fresh.begin, [&](size_t l) { fn(l, r); });
+}
+
+// The end table_end() gives for a limit short of the one `end` was found
+// with: the entries only stop earlier.
+uint32_t truncate_table(uint32_t begin, uint32_t end, uint64_t limit)
+{
+    return uint32_t(std::min<uint64_t>(end, begin + (limit - begin) / 4 * 4));
+}
+
+} // namespace
+
+Heuristics::Heuristics(const Image& image, const SupersetTable& table, const Bitset& is_instr, const Cfg& cfg,
+                       const ReusedObjects* reused, unsigned threads)
+    : image_(image), table_(table), is_instr_(is_instr), cfg_(cfg), text_(*image.text_segment()), threads_(threads),
+      reused_(table.size()),
+      writes_(table.size(), kAllRegisters), unsaved_reads_(table.size(), 0), saves_(table.size(), kAllRegisters)
+{
+    if (reused)
+        reuse_objects(*reused);
+    extract_facts();
+    add_rules();
+}
+
+namespace {
+
+// Whether a terminator, maybe followed by padding, ends right before
+// `offset` of the text. Decodes the bytes itself: it also runs before the
+// superset table is built.
+bool after_terminator(const Segment& text, size_t offset)
+{
+    const uint8_t* code = text.data.data();
+    Instruction insn;
+    for (int steps = 0; steps < 16; ++steps) {
+        if (offset == 0)
+            return true;
+        size_t prev = offset;
+        for (size_t back = 1; back <= 15 && back <= offset; ++back) {
+            const size_t start = offset - back;
+            if (decode(code + start, text.filesz() - start, text.vaddr + uint32_t(start), insn) != DecodeStatus::Ok
+                || insn.length != back)
+                continue;
+            if (is_terminator(insn.flow))
+                return true;
+            if (is_padding(insn))
+                prev = start;
+        }
+        if (prev == offset)
+            return false;
+        offset = prev;
+    }
+    return false;
+}
+
+ObjectKind cached_kind(const Signature& sig)
+{
+    switch (sig.name.empty() ? 'f' : sig.name.back()) {
+    case 'r': return ObjectKind::ReadOnly;
+    case 'd': return ObjectKind::Data;
+    default: return ObjectKind::Function;
+    }
+}
+
+} // namespace
+
+ReusedObjects Heuristics::find_reused(const Image& image, const SignatureDb& known)
+{
+    const Segment& text = *image.text_segment();
+    ReusedObjects out;
+    out.undecoded = Bitset(text.filesz());
+    out.skipped = Bitset(text.filesz());
+    if (known.empty())
+        return out;
+
+    // Functions first: one must start right after a terminator or padding
+    // and end where the old one did, at the end of the code, at padding or
+    // at the next function found again; a longer function that merely
+    // starts the same is left to the heuristics. Its bytes must decode into
+    // whole instructions up to there: the superset leaves the offsets
+    // between them undecoded.
+    const uint8_t* code = text.data.data();
+    std::vector<SignatureDb::Hit> functions;
+    for (const SignatureDb::Hit& hit : known.find(text.data))
+        if (cached_kind(*hit.signature) == ObjectKind::Function)
+            functions.push_back(hit);
+    std::vector<std::pair<uint32_t, uint32_t>> taken; // [begin, end) offsets of the text, sorted
+    Instruction insn;
+    for (size_t h = 0; h < functions.size(); ++h) {
+        const uint32_t begin = functions[h].offset, end = begin + uint32_t(functions[h].signature->size());
+        if ((!taken.empty() && begin < taken.back().second) || !after_terminator(text, begin))
+            continue;
+        bool at_end = end == text.filesz() || (h + 1 < functions.size() && functions[h + 1].offset == end);
+        if (!at_end && decode(code + end, text.filesz() - end, text.vaddr + end, insn) == DecodeStatus::Ok)
+            at_end = is_padding(insn);
+        if (!at_end)
+            continue;
+        std::vector<uint32_t> insns;
+        uint32_t offset = begin;
+        while (offset < end && decode(code + offset, end - offset, text.vaddr + offset, insn) == DecodeStatus::Ok) {
+            insns.push_back(offset);
+            offset += insn.length;
+        }
+        if (offset != end)
+            continue;
+
+        const Signature& sig = *functions[h].signature;
+        taken.push_back({begin, end});
+        out.objects.push_back({text.vaddr + begin, &sig, ObjectKind::Function});
+        for (uint32_t o = begin + 1; o < end; ++o)
+            out.undecoded.set(o);
+        for (uint32_t o : insns)
+            out.undecoded.reset(o);
+        // GOT-relative fields still need the GOT the heuristics find, so
+        // such functions are analysed again.
+        const bool got_relative = std::any_of(sig.relocs.begin(), sig.relocs.end(), [](const SignatureReloc& rel) {
+            return rel.type != R_386_32 && rel.type != R_386_PC32;
+        });
+        if (!got_relative)
+            for (uint32_t o = begin + 1; o < end; ++o)
+                out.skipped.set(o);
+    }
+
+    // Data objects anywhere the functions left. Unlike code, data repeats
+    // (arrays of structures): one found more than once is left alone.
+    std::vector<std::vector<SignatureDb::Hit>> hits;
+    std::map<const Signature*, size_t> found;
+    for (const Segment& seg : image.segments) {
+        hits.push_back(known.find(seg.data));
+        for (const SignatureDb::Hit& hit : hits.back())
+            ++found[hit.signature];
+    }
+    for (size_t i = 0; i < image.segments.size(); ++i) {
+        const Segment& seg = image.segments[i];
+        uint32_t matched_end = 0;
+        for (const SignatureDb::Hit& hit : hits[i]) {
+            const ObjectKind kind = cached_kind(*hit.signature);
+            const uint32_t end = hit.offset + uint32_t(hit.signature->size());
+            if (kind == ObjectKind::Function || hit.offset < matched_end || found[hit.signature] != 1)
+                continue;
+            if (&seg == &text) {
+                auto next = std::lower_bound(taken.begin(), taken.end(), std::make_pair(hit.offset, 0u));
+                if ((next != taken.end() && next->first < end)
+                    || (next != taken.begin() && std::prev(next)->second > hit.offset))
+                    continue;
+            }
+            matched_end = end;
+            out.objects.push_back({seg.vaddr + hit.offset, hit.signature, kind});
+        }
+    }
+    std::sort(out.objects.begin(), out.objects.end(),
+              [](const ReusedObject& a, const ReusedObject& b) { return a.addr < b.addr; });
+    return out;
+}
+
+void Heuristics::reuse_objects(const ReusedObjects& reused)
+{
+    for (const ReusedObject& obj : reused.objects) {
+        const Signature& sig = *obj.signature;
+        const Segment& seg = *image_.segment_at(obj.addr);
+        const uint8_t* bytes = seg.data.data() + (obj.addr - seg.vaddr);
+        reused_ranges_.push_back({obj.addr, obj.addr + uint32_t(sig.size())});
+        if (obj.kind == ObjectKind::Function) {
+            apply_match(obj.addr, sig);
+            ++reused_functions_;
+        } else {
+            matched.insert({obj.addr, obj.addr + uint32_t(sig.size())});
+            for (const SignatureReloc& rel : sig.relocs)
+                sig_reloc.insert({obj.addr + rel.offset, rel.type, read32(bytes + rel.offset)});
+            ++reused_data_;
+        }
+        // What the skipped instructions and words would have said about
+        // functions: call targets are, addresses taken at a boundary are.
+        for (const SignatureReloc& rel : sig.relocs) {
+            const uint32_t site = obj.addr + rel.offset;
+            const uint32_t field = read32(bytes + rel.offset);
+            if (rel.type == R_386_PC32 && rel.offset && bytes[rel.offset - 1] == 0xE8) {
+                if (table_.contains(site + 4 + field))
+                    add_function(site + 4 + field);
+            } else if (rel.type == R_386_32 && table_.contains(field)) {
+                const size_t target = field - table_.base;
+                if (is_instr_.test(target) && after_terminator(text_, target)
+                    && (obj.kind != ObjectKind::Function || immediate_field(site)))
+                    add_function(field);
+            }
+        }
+    }
+    reused_ = reused.skipped;
+}
+
+bool Heuristics::immediate_field(uint32_t site) const
+{
+    // A disp32 is the base of a table the code reads, not a taken address.
+    const size_t field = site - table_.base;
+    for (size_t back = 1; back < 15 && back <= field; ++back)
+        if (table_.valid(field - back) && table_.imm_offset[field - back] == back)
+            return true;
+    return false;
+}
+
+void Heuristics::apply_match(uint32_t addr, const Signature& sig)
+{
+    const uint32_t offset = addr - table_.base;
+    add_function(addr);
+    matched.insert({addr, addr + uint32_t(sig.size())});
+    for (const SignatureReloc& rel : sig.relocs) {
+        const uint32_t site = addr + rel.offset;
+        uint32_t target = 0;
+        if (rel.type == R_386_32)
+            target = read32(text_.data.data() + offset + rel.offset);
+        else if (rel.type == R_386_PC32)
+            target = site + 4 + read32(text_.data.data() + offset + rel.offset);
+        sig_reloc.insert({site, rel.type, target});
+    }
+}
+
+std::vector<Signature> Heuristics::object_signatures(const Symbolization& result) const
+{
+    // The end of the last instruction of every function; what follows up to
+    // the next object is padding, which differs from build to build.
+    std::map<uint32_t, uint32_t> code_end;
+    for (size_t r = 0; r < member.size(); ++r) {
+        const uint32_t insn = member.at(r, 0);
+        uint32_t& end = code_end[member.at(r, 1)];
+        end = std::max(end, insn + table_.length[insn - table_.base]);
+    }
+    // Matched functions were not followed past their start.
+    for (size_t r = 0; r < matched.size(); ++r) {
+        uint32_t& end = code_end[matched.at(r, 0)];
+        end = std::max(end, matched.at(r, 1));
+    }
+
+    std::vector<Signature> signatures;
+    auto rel = result.relocations.begin();
+    for (const Object& obj : result.objects) {
+        // Data is only worth keeping for the pointers it holds.
+        uint32_t size = obj.size;
+        if (obj.kind == ObjectKind::Function) {
+            auto it = code_end.find(obj.addr);
+            if (it == code_end.end() || it->second > obj.end())
+                continue;
+            size = it->second - obj.addr;
+        } else if (obj.kind == ObjectKind::Bss) {
+            continue;
+        }
+        const Segment* seg = image_.segment_at(obj.addr);
+        if (!seg || obj.addr - seg->vaddr + size > seg->filesz())
+            continue;
+        Signature sig;
+        char name[16];
+        std::snprintf(name, sizeof(name), "x%08x%c", obj.addr, "frdb"[size_t(obj.kind)]);
+        sig.name = name;
+        const uint8_t* bytes = seg->data.data() + (obj.addr - seg->vaddr);
+        sig.bytes.assign(bytes, bytes + size);
+        sig.mask.assign(size, 0xFF);
+        while (rel != result.relocations.end() && rel->site < obj.addr)
+            ++rel;
+        bool absolute = true;
+        for (; rel != result.relocations.end() && rel->site < obj.end(); ++rel) {
+            const uint32_t at = rel->site - obj.addr;
+            if (at + 4 > size)
+                continue;
+            absolute &= rel->type == R_386_32;
+            std::fill_n(sig.mask.begin() + at, 4, 0);
+            std::fill_n(sig.bytes.begin() + at, 4, 0);
+            sig.relocs.push_back({at, rel->type});
+        }
+        if (obj.kind == ObjectKind::Function || (absolute && !sig.relocs.empty()))
+            signatures.push_back(std::move(sig));
+    }
+    return signatures;
+}
+
+std::vector<AddressWindow> Heuristics::pointer_windows() const
+{
+    std::vector<AddressWindow> windows;
+    for (const Segment& seg : image_.segments)
+        if (seg.memsz)
+            windows.push_back({seg.vaddr, seg.memsz});
+    windows.push_back({kRamOrigin, kRamSize});
+    return windows;
+}
+
+bool Heuristics::clobbered_by_thunk(uint32_t insn, uint32_t reg) const
+{
+    bool clobbered = false;
+    call.for_key(insn, call.size(), [&](size_t k) {
+        thunk.for_key(call.at(k, 1), thunk.size(), [&](size_t t) { clobbered |= thunk.at(t, 1) == reg; });
+    });
+    return clobbered;
+}
+
+void Heuristics::follow_got(const std::vector<Relation<3>::Tuple>& seeds, GotFacts& facts) const
+{
+    const uint32_t text_end = text_.vaddr + text_.filesz();
+    std::set<Relation<3>::Tuple> seen(seeds.begin(), seeds.end());
+    std::vector<Relation<3>::Tuple> work(seeds.rbegin(), seeds.rend());
+    while (!work.empty()) {
+        const auto [a, reg, got] = work.back();
+        work.pop_back();
+        facts.bases.push_back({a, reg, got});
+
+        // disp32(%got_reg): GOT32 when it lands in .got proper, GOTOFF
+        // otherwise; add $sym@GOTOFF,%got_reg points the register at sym.
+        const uint32_t offset = a - table_.base;
+        based_disp.for_key(a, based_disp.size(), [&](size_t d) {
+            if (based_disp.at(d, 1) != reg)
+                return;
+            const uint32_t target = got + based_disp.at(d, 2);
+            const bool in_got = target - got >= kGotPltSize && target < text_end && target >= got;
+            facts.relocs.push_back({a + table_.disp_offset[offset], uint32_t(in_got ? R_386_GOT32 : R_386_GOTOFF),
+                                    target});
+        });
+        got_add.for_key(a, got_add.size(), [&](size_t g) {
+            if (got_add.at(g, 1) == reg)
+                facts.relocs.push_back({a + table_.imm_offset[offset], R_386_GOTOFF, got + got_add.at(g, 2)});
+        });
+        if (reg == kEbx) {
+            call.for_key(a, call.size(), [&](size_t k) {
+                const uint32_t t = call.at(k, 1);
+                if (table_.contains(t) && !thunk.contains_key(t) && table_.flow[t - table_.base] != Flow::IndirectJump)
+                    facts.callees.emplace_back(t, got);
+            });
+            // Tail calls hand the GOT on as well.
+            tail_call.for_key(a, tail_call.size(), [&](size_t k) { facts.callees.emplace_back(tail_call.at(k, 1), got); });
+            jump.for_key(a, jump.size(), [&](size_t k) {
+                if (function.contains({jump.at(k, 1)}))
+                    facts.callees.emplace_back(jump.at(k, 1), got);
+            });
+        }
+
+        if (writes_[offset] >> reg & 1 || clobbered_by_thunk(a, reg))
+            continue;
+        for (const Relation<2>* edge : {&fallthrough, &jump, &table_target}) {
+            edge->for_key(a, edge->size(), [&](size_t e) {
+                const uint32_t b = edge->at(e, 1);
+                if (!function.contains({b}) && seen.insert({b, reg, got}).second)
+                    work.push_back({b, reg, got});
+            });
+        }
+    }
+}
+
+void Heuristics::derive_got_bases()
+{
+    // A task per function: the set-ups inside it first, then the functions
+    // entered with the GOT in %ebx, round by round until no call adds one.
+    // Tasks only read the relations; their facts are inserted afterwards in
+    // task order, so the result does not depend on the threads.
+    std::vector<uint32_t> starts(function.column(0));
+    std::sort(starts.begin(), starts.end());
+    std::map<uint32_t, std::vector<Relation<3>::Tuple>> tasks;
+    for (size_t r = 0; r < got_setup.size(); ++r) {
+        const uint32_t s = got_setup.at(r, 0);
+        auto it = std::upper_bound(starts.begin(), starts.end(), s);
+        const uint32_t owner = it == starts.begin() ? 0 : *std::prev(it);
+        fallthrough.for_key(s, fallthrough.size(), [&](size_t e) {
+            tasks[owner].push_back({fallthrough.at(e, 1), got_setup.at(r, 1), got_setup.at(r, 2)});
+        });
+    }
+
+    std::set<std::pair<uint32_t, uint32_t>> entered;
+    while (!tasks.empty()) {
+        std::vector<std::vector<Relation<3>::Tuple>> seeds;
+        seeds.reserve(tasks.size());
+        for (auto& [start, task] : tasks)
+            seeds.push_back(std::move(task));
+        tasks.clear();
+
+        std::vector<GotFacts> facts(seeds.size());
+        parallel_tasks(seeds.size(), threads_, [&](size_t, size_t t) { follow_got(seeds[t], facts[t]); });
+        for (const GotFacts& f : facts) {
+            for (const auto& row : f.bases)
+                got_base.insert(row);
+            for (const auto& row : f.relocs)
+                reloc.insert(row);
+            for (const auto& [callee, got] : f.callees)
+                if (entered.emplace(callee, got).second)
+                    tasks[callee].push_back({callee, kEbx, got});
+        }
+    }
+}
+
+void Heuristics::emit_code_relocs(const RuleContext& ctx)
+{
+    // The rows each rule joins, gathered by the function holding the
+    // instruction; a task per function reads them into one slot each, and
+    // the slots are inserted in the order the rows were gathered.
+    enum Kind : uint8_t { GotPc, Call, Jump, BranchZero, Imm, Disp };
+    struct Site {
+        Kind kind;
+        uint32_t row;
+    };
+    std::vector<Site> sites;
+    const Range setups = ctx.delta(got_setup);
+    for (size_t r = setups.begin; r < setups.end; ++r)
+        sites.push_back({GotPc, uint32_t(r)});
+    join(ctx, code, call, [&](size_t, size_t r) { sites.push_back({Call, uint32_t(r)}); });
+    join(ctx, code, jump, [&](size_t, size_t r) { sites.push_back({Jump, uint32_t(r)}); });
+    join(ctx, code, branch_zero, [&](size_t, size_t r) { sites.push_back({BranchZero, uint32_t(r)}); });
+    join(ctx, code, imm_ref, [&](size_t, size_t r) { sites.push_back({Imm, uint32_t(r)}); });
+    join(ctx, code, disp_ref, [&](size_t, size_t r) { sites.push_back({Disp, uint32_t(r)}); });
+
+    const auto insn = [&](const Site& site) {
+        switch (site.kind) {
+        case GotPc: return got_setup.at(site.row, 0);
+        case Call: return call.at(site.row, 0);
+        case Jump: return jump.at(site.row, 0);
+        case BranchZero: return branch_zero.at(site.row, 0);
+        case Imm: return imm_ref.at(site.row, 0);
+        case Disp: return disp_ref.at(site.row, 0);
+        }
+        return uint32_t(0);
+    };
+    // R_386_NONE where a row yields no relocation.
+    const auto relocate = [&](const Site& site) -> Relation<3>::Tuple {
+        const uint32_t a = insn(site);
+        const uint32_t imm = a + table_.imm_offset[a - table_.base];
+        switch (site.kind) {
+        case GotPc: return {imm, R_386_GOTPC, got_setup.at(site.row, 2)};
+        case Call: return {imm, R_386_PC32, call.at(site.row, 1)};
+        case BranchZero: return {imm, R_386_PC32, 0};
+        case Imm: return {imm, R_386_32, imm_ref.at(site.row, 1)};
+        case Disp: return {a + table_.disp_offset[a - table_.base], R_386_32, disp_ref.at(site.row, 1)};
+        case Jump: break;
+        }
+        const uint32_t t = jump.at(site.row, 1);
+        bool shared = false;
+        member.for_key(a, member.size(), [&](size_t m) { shared |= member.contains({t, member.at(m, 1)}); });
+        if (imm == a || shared)
+            return {a, R_386_NONE, 0};
+        return {imm, R_386_PC32, t};
+    };
+
+    std::map<uint32_t, std::vector<size_t>> by_function;
+    for (size_t i = 0; i < sites.size(); ++i)
+        by_function[owner(insn(sites[i]))].push_back(i);
+    std::vector<std::vector<size_t>> tasks;
+    tasks.reserve(by_function.size());
+    for (auto& [function, task] : by_function)
+        tasks.push_back(std::move(task));
+    std::vector<Relation<3>::Tuple> rows(sites.size());
+    parallel_tasks(tasks.size(), threads_, [&](size_t, size_t t) {
+        for (size_t i : tasks[t])
+            rows[i] = relocate(sites[i]);
+    });
+    for (const Relation<3>::Tuple& row : rows)
+        if (row[1] != R_386_NONE)
+            reloc.insert(row);
+}
+
+bool Heuristics::is_code_byte(uint32_t addr) const
+{
+    for (uint32_t back = 0; back < 15 && back <= addr - table_.base; ++back) {
+        const uint32_t start = addr - back;
+        if (table_.contains(start) && code.contains({start}) && back < table_.length[start - table_.base])
+            return true;
+    }
+    return false;
+}
+
+Heuristics::RegisterValue Heuristics::trace_register(uint32_t addr, uint32_t reg,
+                                                     std::vector<uint32_t>& pending) const
+{
+    // Back along the code path, over register copies, to the mov $imm that
+    // loads reg. The path ends where the code has no predecessor, and is
+    // lost where it has several (a join) or an instruction computes reg.
+    // Predecessors not known as code yet go to `pending`: once one is, the
+    // path may have changed and the caller has to trace again.
+    size_t offset = addr - table_.base;
+    Instruction insn;
+    for (int steps = 0; steps < kMaxTraceSteps; ++steps) {
+        const uint32_t b = cfg_.block_of[offset];
+        const Span<uint32_t> insns = cfg_.instructions(b);
+        size_t prev = table_.size();
+        if (offset != cfg_.first(b)) {
+            prev = *(std::lower_bound(insns.begin(), insns.end(), uint32_t(offset)) - 1);
+        } else {
+            for (uint32_t p : cfg_.predecessors(b)) {
+                const uint32_t last = table_.address(cfg_.last(p));
+                if (!code.contains({last})) {
+                    pending.push_back(last);
+                    continue;
+                }
+                if (prev != table_.size())
+                    return {};
+                prev = cfg_.last(p);
+            }
+            if (prev == table_.size())
+                return {RegisterValue::Incoming, reg, table_.address(offset)};
+        }
+        offset = prev;
+        if (!(writes_[offset] >> reg & 1))
+            continue;
+        decode(text_.data.data() + offset, table_.size() - offset, table_.address(offset), insn);
+        if (insn.opsize16)
+            return {};
+        if (insn.opcode == 0xB8 + reg || (insn.opcode == 0xC7 && insn.mod() == 3 && insn.rm() == reg))
+            return {RegisterValue::Literal, insn.imm};
+        if (insn.opcode == 0x89 && insn.mod() == 3 && insn.rm() == reg)
+            reg = insn.reg();
+        else if (insn.opcode == 0x8B && insn.mod() == 3 && insn.reg() == reg)
+            reg = insn.rm();
+        else
+            return {};
+    }
+    return {};
+}
+
+void Heuristics::trace_jump(uint32_t jmp, uint32_t reg)
+{
+    std::vector<uint32_t> pending;
+    const RegisterValue v = trace_register(jmp, reg, pending);
+    for (uint32_t insn : pending)
+        retrace.insert({insn, jmp});
+    if (v.kind == RegisterValue::Incoming && kCallerSaved >> v.value & 1)
+        arg_jump.insert({v.entry, v.value, jmp});
+    if (v.kind != RegisterValue::Literal || !instr.contains({v.value}))
+        return;
+    if (boundary.contains({v.value})) {
+        tail_call.insert({jmp, v.value});
+    } else {
+        code.insert({v.value});
+        label.insert({v.value});
+    }
+}
+
+void Heuristics::trace_argument(uint32_t call_insn, size_t arg_row)
+{
+    std::vector<uint32_t> pending;
+    const RegisterValue v = trace_register(call_insn, arg_jump.at(arg_row, 1), pending);
+    for (uint32_t insn : pending)
+        retrace.insert({insn, call_insn});
+    if (v.kind == RegisterValue::Literal && table_.contains(v.value))
+        tail_call.insert({arg_jump.at(arg_row, 2), v.value});
+}
+
+// The string literal (address, literal) that addr is part of, if any.
+const std::pair<const uint32_t, StringLiteral>* Heuristics::string_run(uint32_t addr) const
+{
+    auto it = strings_.upper_bound(addr);
+    if (it == strings_.begin() || addr - std::prev(it)->first >= std::prev(it)->second.size)
+        return nullptr;
+    return &*std::prev(it);
+}
+
+void Heuristics::extract_facts()
+{
+    entry.insert({image_.entry});
+    boundary.insert({table_.base});
+
+    // Every dword of every segment that may hold an address, found in one
+    // vector pass per segment rather than value by value.
+    const std::vector<AddressWindow> windows = pointer_windows();
+    std::vector<Bitset> pointers;
+    for (const Segment& seg : image_.segments)
+        pointers.push_back(find_pointer_literals(seg.data, windows));
+    const Bitset& text_pointers = pointers[&text_ - image_.segments.data()];
+
+    Instruction insn;
+    for (size_t offset = is_instr_.next(0); offset < table_.size(); offset = is_instr_.next(offset + 1)) {
+        if (reused_.test(offset))
+            continue;
+        const uint32_t addr = table_.address(offset);
+        const uint8_t* bytes = text_.data.data() + offset;
+        decode(bytes, table_.size() - offset, addr, insn);
+        const uint32_t next = addr + insn.length;
+        instr.insert({addr});
+        writes_[offset] = written_registers(insn);
+        if (!is_padding(insn)) {
+            // Pushing a register saves it: the code may read it from then on.
+            const bool save = insn.opcode >= 0x50 && insn.opcode < 0x58;
+            unsaved_reads_[offset] = save ? 0 : read_registers(insn) & kNonArgument;
+            saves_[offset] = uint8_t(writes_[offset] | (save ? read_registers(insn) : 0));
+        }
+
+        if (falls_through(insn.flow) && table_.contains(next))
+            fallthrough.insert({addr, next});
+        if (is_terminator(insn.flow))
+            boundary.insert({next});
+        if (is_padding(insn))
+            padding.insert({addr, next});
+
+        if (has_direct_target(insn.flow)) {
+            if (insn.target == 0)
+                branch_zero.insert({addr});
+            else if (insn.flow == Flow::Call && insn.target == next)
+                call_next.insert({addr, next});
+            else if (insn.flow == Flow::Call) {
+                call.insert({addr, insn.target});
+                caller.insert({insn.target, addr});
+            } else
+                jump.insert({addr, insn.target});
+        } else if (insn.imm_offset && text_pointers.test(offset + insn.imm_offset)) {
+            imm_ref.insert({addr, insn.imm});
+        } else if (insn.opcode == 0xC7 && insn.mod() == 3 && !insn.opsize16) {
+            // gas encodes mov $imm,%reg as B8+r; C7 /0 is left behind by the
+            // linker relaxing mov sym@GOT(%reg),%reg, even for absolute symbols.
+            imm_ref.insert({addr, insn.imm});
+        }
+
+        if (insn.disp_offset) {
+            const uint32_t base = insn.has_modrm ? base_register(insn) : kNoRegister;
+            if (base != kNoRegister)
+                based_disp.insert({addr, base, uint32_t(insn.disp)});
+            if (text_pointers.test(offset + insn.disp_offset))
+                disp_ref.insert({addr, uint32_t(insn.disp)});
+        }
+
+        // mov (%esp),%reg; ret
+        if (insn.opcode == 0x8B && insn.mod() == 0 && insn.rm() == 4 && insn.sib == 0x24 && insn.length == 3
+            && table_.contains(next) && bytes[3] == 0xC3)
+            thunk.insert({addr, insn.reg()});
+        if (insn.opcode == 0x81 && insn.mod() == 3 && insn.reg() == 0 && !insn.opsize16)
+            got_add.insert({addr, insn.rm(), insn.imm});
+        if (insn.opcode == 0x05 && !insn.opsize16) // add $imm32,%eax
+            got_add.insert({addr, 0, insn.imm});
+        if (insn.opcode >= 0x58 && insn.opcode <= 0x5F)
+            pop_reg.insert({addr, uint32_t(insn.opcode - 0x58)});
+        find_indexed_jump(offset, insn);
+        if (insn.opcode == 0xFF && insn.reg() == 4 && insn.mod() == 3)
+            reg_jump.insert({addr, insn.rm()});
+        // mov $0,%reg; test %reg,%reg: the guard of a call to a weak symbol.
+        if (insn.opcode >= 0xB8 && insn.opcode <= 0xBF && insn.imm == 0 && !insn.opsize16
+            && offset + 7 <= table_.size() && bytes[5] == 0x85 && bytes[6] == (0xC0 | (insn.opcode - 0xB8) * 9))
+            mov0_test.insert({addr, uint32_t(insn.opcode - 0xB8)});
+    }
+
+    propagate_unsaved_reads();
+    add_table_candidates(indexed_jump.column(1), 0);
+
+    // Reused objects tell what their bytes hold: only the gaps between them
+    // are searched for literals and pointers.
+    for (size_t i = 0; i < image_.segments.size(); ++i) {
+        const Segment& seg = image_.segments[i];
+        std::vector<std::pair<uint32_t, uint32_t>> gaps; // offsets
+        uint32_t at = 0;
+        for (auto it = std::lower_bound(reused_ranges_.begin(), reused_ranges_.end(), std::make_pair(seg.vaddr, 0u));
+             it != reused_ranges_.end() && it->first - seg.vaddr < seg.filesz(); ++it) {
+            if (it->first - seg.vaddr > at)
+                gaps.push_back({at, it->first - seg.vaddr});
+            at = std::max(at, it->second - seg.vaddr);
+        }
+        if (at < seg.filesz())
+            gaps.push_back({at, seg.filesz()});
+        for (const auto& [begin, end] : gaps) {
+            for (StringLiteral s : find_strings(Span<uint8_t>(seg.data.data() + begin, end - begin))) {
+                s.offset += begin;
+                strings_.emplace(seg.vaddr + s.offset, s);
+            }
+            for (size_t off = pointers[i].next(begin); off < end; off = pointers[i].next(off + 1))
+                if ((seg.vaddr + off) % 4 == 0)
+                    data_word.insert({uint32_t(seg.vaddr + off), read32(seg.data.data() + off)});
+        }
+    }
+    find_pointer_runs();
+    score_function_starts();
+}
+
+void Heuristics::find_pointer_runs()
+{
+    // Aligned words next to each other that all hold candidate instructions
+    // and no jmp indexes: a table of function pointers called through
+    // (func_jumptable[2](...) in tricky_part1.S).
+    const auto entry = [&](size_t r) {
+        const uint32_t target = data_word.at(r, 1);
+        return table_.contains(target) && is_instr_.test(target - table_.base)
+               && !table_candidates_.find(data_word.at(r, 0));
+    };
+    for (size_t r = 0; r < data_word.size();) {
+        size_t end = r;
+        while (end < data_word.size() && entry(end)
+               && (end == r || data_word.at(end, 0) == data_word.at(end - 1, 0) + 4))
+            ++end;
+        if (end - r >= kMinPointerRun)
+            for (size_t i = r; i < end; ++i)
+                pointer_run.insert({data_word.at(i, 0), data_word.at(i, 1)});
+        r = std::max(end, r + 1);
+    }
+}
+
+void Heuristics::score_function_starts()
+{
+    FunctionScores scores(table_.size());
+    const uint8_t* code = text_.data.data();
+    // Addresses outside the text wrap around to offsets past its end.
+    const auto offsets = [&](const std::vector<uint32_t>& addrs) {
+        std::vector<uint32_t> out(addrs.size());
+        for (size_t i = 0; i < addrs.size(); ++i)
+            out[i] = addrs[i] - table_.base;
+        return out;
+    };
+
+    scores.add(offsets(call.column(1)), kCallTarget);
+    scores.add(offsets(imm_ref.column(1)), kCodePointer);
+    std::vector<uint32_t> pointers;
+    for (size_t r = 0; r < data_word.size(); ++r)
+        if (!table_candidates_.find(data_word.at(r, 0))) // switch cases are labels
+            pointers.push_back(data_word.at(r, 1) - table_.base);
+    scores.add(pointers, kCodePointer);
+    std::vector<uint32_t> tail_jumps;
+    for (size_t r = 0; r < jump.size(); ++r)
+        if (code[jump.at(r, 0) - table_.base] == 0xE9)
+            tail_jumps.push_back(jump.at(r, 1) - table_.base);
+    scores.add(tail_jumps, kTailJumpTarget);
+
+    // Boundaries in one prefix pass: padding rows come in address order,
+    // so each run of padding is walked once from its terminator.
+    Bitset at_boundary(table_.size());
+    for (uint32_t b : offsets(boundary.column(0)))
+        if (b < table_.size())
+            at_boundary.set(b);
+    std::vector<uint32_t> aligned;
+    for (size_t r = 0; r < padding.size(); ++r) {
+        const uint32_t a = padding.at(r, 0) - table_.base, b = padding.at(r, 1) - table_.base;
+        if (b < table_.size() && at_boundary.test(a)) {
+            at_boundary.set(b);
+            if (padding.at(r, 1) % 4 == 0)
+                aligned.push_back(b);
+        }
+    }
+    std::vector<uint32_t> boundaries;
+    for (size_t b = at_boundary.next(0); b < table_.size(); b = at_boundary.next(b + 1))
+        boundaries.push_back(uint32_t(b));
+    scores.add(boundaries, kAfterBoundary);
+    scores.add(aligned, kAligned);
+
+    std::vector<uint32_t> frames, saves;
+    for (size_t o = is_instr_.next(0); o < table_.size(); o = is_instr_.next(o + 1)) {
+        if (reused_.test(o) || !saves_register(code[o]) || prologue_start(code, o) != o)
+            continue;
+        saves.push_back(uint32_t(o));
+        if (o + 3 <= table_.size() && is_frame_setup(code + o))
+            frames.push_back(uint32_t(o));
+    }
+    scores.add(saves, kSavesRegisters);
+    scores.add(frames, kFramePrologue);
+
+    // call __x86.get_pc_thunk.reg after the pushes that open a function.
+    std::vector<uint32_t> got_prologues;
+    for (size_t r = 0; r < call.size(); ++r) {
+        if (!thunk.contains_key(call.at(r, 1)))
+            continue;
+        got_prologues.push_back(uint32_t(prologue_start(code, call.at(r, 0) - table_.base)));
+    }
+    scores.add(got_prologues, kGotPrologue);
+
+    // What the ABI or the data rule out: a start reading a register it has
+    // not saved, one inside a string literal. One inside a candidate jump
+    // table waits for the table to be confirmed (release_tables).
+    const Bitset picked = scores.at_least(kFunctionScore);
+    for (size_t o = picked.next(0); o < table_.size(); o = picked.next(o + 1)) {
+        const uint32_t addr = table_.address(o);
+        if (!is_instr_.test(o) || reused_.test(o) || unsaved_reads_[o] != 0)
+            continue;
+        if (const auto* run = string_run(addr); run && run->second.confidence >= kConfidentString)
+            continue;
+        if (table_candidates_.find(addr))
+            held_starts_.push_back(addr);
+        else
+            scored_start.insert({addr});
+    }
+}
+
+void Heuristics::propagate_unsaved_reads()
+{
+    // Backward liveness of the non-argument registers over the candidate
+    // CFG: in(a) = reads(a) | (out(a) & ~saves(a)), out(a) the union over the
+    // successors. Each block is first folded into one such pair of masks;
+    // walking the blocks from the end settles every forward edge at once,
+    // so only loops need another sweep.
+    const size_t blocks = cfg_.blocks();
+    std::vector<uint8_t> reads(blocks), saves(blocks), in(blocks);
+    for (size_t b = 0; b < blocks; ++b) {
+        uint8_t r = 0, k = 0;
+        const Span<uint32_t> insns = cfg_.instructions(b);
+        for (size_t i = insns.size(); i-- > 0;) {
+            r = uint8_t(unsaved_reads_[insns[i]] | (r & ~saves_[insns[i]]));
+            k |= saves_[insns[i]];
+        }
+        reads[b] = in[b] = r;
+        saves[b] = k;
+    }
+    const auto out = [&](size_t b) {
+        uint8_t mask = 0;
+        for (uint32_t s : cfg_.successors(b))
+            mask |= in[s];
+        return mask;
+    };
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t b = blocks; b-- > 0;) {
+            const uint8_t mask = uint8_t(reads[b] | (out(b) & ~saves[b]));
+            if (mask != in[b]) {
+                in[b] = mask;
+                changed = true;
+            }
+        }
+    }
+
+    // Back to every instruction: taken addresses need not start a block.
+    for (size_t b = 0; b < blocks; ++b) {
+        uint8_t mask = out(b);
+        const Span<uint32_t> insns = cfg_.instructions(b);
+        for (size_t i = insns.size(); i-- > 0;) {
+            mask = uint8_t(unsaved_reads_[insns[i]] | (mask & ~saves_[insns[i]]));
+            unsaved_reads_[insns[i]] = mask;
+        }
+    }
+}
+
+void Heuristics::taken_address(uint32_t addr)
+{
+    // A literal right after a jmp ("L\xe8t" in tricky_part1.S) decodes too;
+    // what runs from addr to the NUL is scored on its own.
+    if (const auto* run = string_run(addr)) {
+        const uint32_t end = run->first + run->second.size;
+        if (classify_text(text_.data.data() + (addr - text_.vaddr), end - addr).confidence >= kConfidentString)
+            return;
+    }
+    if (unsaved_reads_[addr - table_.base] == 0) {
+        function.insert({addr});
+    } else {
+        code.insert({addr});
+        label.insert({addr});
+    }
+}
+
+void Heuristics::find_indexed_jump(size_t offset, const Instruction& insn)
+{
+    // jmp *T(,%i,4), or mov T(,%i,4),%r; jmp *%r. In PIC code the table
+    // holds GOT offsets: mov T@GOTOFF(%got,%i,4),%r; add %got,%r; jmp *%r.
+    if (!insn.has_sib || insn.mod() == 3 || insn.sib >> 6 != 2 || !has_index(insn))
+        return;
+    const uint32_t base = base_register(insn);
+    const uint32_t table = uint32_t(insn.disp);
+    if (insn.opcode == 0xFF && insn.reg() == 4) {
+        if (base == kNoRegister)
+            indexed_jump.insert({table_.address(offset), table});
+        return;
+    }
+    const uint32_t dest = insn.reg();
+    if (insn.opcode != 0x8B || dest == base)
+        return;
+
+    Instruction next;
+    const auto decode_next = [&] {
+        offset += table_.length[offset];
+        if (offset >= table_.size() || !table_.valid(offset))
+            return false;
+        decode(text_.data.data() + offset, table_.size() - offset, table_.address(offset), next);
+        return true;
+    };
+    if (base != kNoRegister) {
+        if (!decode_next() || next.mod() != 3
+            || !((next.opcode == 0x01 && next.reg() == base && next.rm() == dest)
+                 || (next.opcode == 0x03 && next.reg() == dest && next.rm() == base)))
+            return;
+    }
+    if (!decode_next() || next.opcode != 0xFF || next.reg() != 4 || next.mod() != 3 || next.rm() != dest)
+        return;
+    if (base == kNoRegister)
+        indexed_jump.insert({table_.address(offset), table});
+    else
+        got_indexed_jump.insert({table_.address(offset), table});
+}
+
+void Heuristics::add_table_candidates(std::vector<uint32_t> starts, uint32_t bias)
+{
+    // Each table runs to its first entry that is no candidate instruction,
+    // to the next table start or to a table found before. Most of them
+    // belong to jmps that are no code: they only hold back what their words
+    // would say until the fixpoint tells (release_tables). The entries are
+    // read one table per task; the tables are added in address order.
+    std::sort(starts.begin(), starts.end());
+    starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+    const auto next = [&](size_t i) { return i + 1 < starts.size() ? starts[i + 1] : UINT32_MAX; };
+    std::vector<uint32_t> ends(starts.size());
+    parallel_tasks(starts.size(), threads_, [&](size_t, size_t i) {
+        ends[i] = table_end(starts[i], table_limit(starts[i], next(i), nullptr), bias);
+    });
+    for (size_t i = 0; i < starts.size(); ++i) {
+        const uint32_t begin = starts[i];
+        const uint32_t end = truncate_table(begin, ends[i], table_limit(begin, next(i), &table_candidates_));
+        if (end != begin)
+            table_candidates_.insert(begin, end);
+    }
+    table_starts_.insert(table_starts_.end(), starts.begin(), starts.end());
+    std::sort(table_starts_.begin(), table_starts_.end());
+}
+
+uint64_t Heuristics::table_limit(uint32_t begin, uint64_t limit, const IntervalTree* known) const
+{
+    const Segment* seg = image_.segment_at(begin);
+    if (begin % 4 || !seg || begin - seg->vaddr >= seg->filesz())
+        return begin;
+    limit = std::min<uint64_t>({limit, uint64_t(seg->vaddr) + seg->filesz(), uint64_t(begin) + 4 * kMaxTableEntries});
+    if (const IntervalTree::Interval* other = known ? known->find_overlap(begin, uint32_t(limit)) : nullptr)
+        return other->begin <= begin ? begin : other->begin;
+    return limit;
+}
+
+uint32_t Heuristics::table_end(uint32_t begin, uint64_t limit, uint32_t bias) const
+{
+    const Segment* seg = image_.segment_at(begin);
+    uint32_t end = begin;
+    for (; limit - end >= 4; end += 4) {
+        const uint32_t target = read32(seg->data.data() + (end - seg->vaddr)) + bias;
+        if (!table_.contains(target) || !is_instr_.test(target - table_.base))
+            break;
+    }
+    return end;
+}
+
+uint32_t Heuristics::table_bound(uint32_t jmp) const
+{
+    // cmp $n,%i; ja default in a block falling through into the one of the
+    // jmp: n + 1 entries (n with jae). 0 if there is no such check.
+    const uint8_t* code = text_.data.data();
+    const uint32_t b = cfg_.block_of[jmp - table_.base];
+    for (uint32_t p : cfg_.predecessors(b)) {
+        const Span<uint32_t> insns = cfg_.instructions(p);
+        if (insns.size() < 2)
+            continue;
+        const uint32_t branch = insns[insns.size() - 1], check = insns[insns.size() - 2];
+        if (branch + table_.length[branch] != cfg_.first(b))
+            continue;
+        Instruction jcc, cmp;
+        decode(code + branch, table_.size() - branch, table_.address(branch), jcc);
+        decode(code + check, table_.size() - check, table_.address(check), cmp);
+        const bool above = jcc.opcode == 0x77 || jcc.opcode == 0x187;
+        if ((!above && jcc.opcode != 0x73 && jcc.opcode != 0x183) || cmp.opsize16)
+            continue;
+        uint32_t n;
+        if (cmp.opcode == 0x83 && cmp.reg() == 7 && cmp.mod() == 3 && code[branch - 1] < 0x80)
+            n = code[branch - 1];
+        else if ((cmp.opcode == 0x81 && cmp.reg() == 7 && cmp.mod() == 3) || cmp.opcode == 0x3D)
+            n = cmp.imm;
+        else
+            continue;
+        if (n < kMaxTableEntries)
+            return above ? n + 1 : n;
+    }
+    return 0;
+}
+
+uint32_t Heuristics::owner(uint32_t addr) const
+{
+    auto it = function_starts_.upper_bound(addr);
+    return it == function_starts_.begin() ? 0 : *std::prev(it);
+}
+
+void Heuristics::settle_tables(std::vector<TableJump>& jumps)
+{
+    // A task per function dispatching through tables: the bound of each of
+    // its jmps and how far their entries point at instructions. The tables
+    // are then settled in the order of `jumps`, so the result does not
+    // depend on the threads.
+    std::map<uint32_t, std::vector<size_t>> by_function;
+    for (size_t i = 0; i < jumps.size(); ++i)
+        by_function[owner(jumps[i].jmp)].push_back(i);
+    std::vector<std::vector<size_t>> tasks;
+    tasks.reserve(by_function.size());
+    for (auto& [function, task] : by_function)
+        tasks.push_back(std::move(task));
+    parallel_tasks(tasks.size(), threads_, [&](size_t, size_t t) {
+        for (size_t i : tasks[t]) {
+            TableJump& j = jumps[i];
+            if (jump_tables_.find(j.table))
+                continue;
+            j.limit = UINT32_MAX;
+            if (const uint32_t entries = table_bound(j.jmp))
+                j.limit = uint64_t(j.table) + 4 * entries;
+            else if (auto next = std::upper_bound(table_starts_.begin(), table_starts_.end(), j.table);
+                     next != table_starts_.end())
+                j.limit = *next;
+            j.end = table_end(j.table, table_limit(j.table, j.limit, nullptr), j.bias);
+        }
+    });
+    for (const TableJump& j : jumps)
+        follow_table(j);
+}
+
+void Heuristics::follow_table(const TableJump& jump)
+{
+    // The extent is settled by the first code jmp through the table: up to
+    // the bound its index is checked against, else up to the next candidate
+    // table, and never into a table settled before.
+    const uint32_t table = jump.table;
+    const IntervalTree::Interval* extent = jump_tables_.find(table);
+    if (!extent || extent->begin != table) {
+        if (extent)
+            return;
+        const uint32_t end = truncate_table(table, jump.end, table_limit(table, jump.limit, &jump_tables_));
+        if (end == table)
+            return;
+        jump_tables_.insert(table, end);
+        extent = jump_tables_.find(table);
+    }
+    const Segment& seg = *image_.segment_at(table);
+    for (uint32_t w = table; w < extent->end; w += 4) {
+        const uint32_t target = read32(seg.data.data() + (w - seg.vaddr)) + jump.bias;
+        table_word.insert({w, target, uint32_t(jump.bias ? R_386_GOTOFF : R_386_32)});
+        if (!instr.contains({target}))
+            continue;
+        table_target.insert({jump.jmp, target});
+        code.insert({target});
+        label.insert({target});
+    }
+}
+
+void Heuristics::add_rules()
+{
+    datalog::Program& p = program_;
+
+    // Stratum 1: where functions may start, right after a terminator or the
+    // padding following one.
+    p.rule("boundary(b) :- boundary(a), padding(a, b)", {&boundary, &padding}, {}, {&boundary},
+           [this](const RuleContext& ctx) {
+               join(ctx, boundary, padding, [&](size_t, size_t e) { boundary.insert({padding.at(e, 1)}); });
+           });
+
+    // Stratum 2: code inference, function starts and GOT set-up idioms.
+    p.stratum();
+    // What its rules keep beside the relations starts over with them.
+    p.on_reset([this] {
+        function_starts_.clear();
+        far_jump_ranges_ = IntervalTree();
+        far_jump_rows_.clear();
+        jump_tables_ = IntervalTree();
+        table_candidates_ = IntervalTree();
+        table_starts_.clear();
+        table_got_ = 0;
+        add_table_candidates(indexed_jump.column(1), 0);
+    });
+    p.rule("code(f) :- function(f), instr(f)", {&function}, {&instr}, {&code}, [this](const RuleContext& ctx) {
+        const Range rows = ctx.delta(function);
+        for (size_t r = rows.begin; r < rows.end; ++r)
+            if (instr.contains({function.at(r, 0)}))
+                code.insert({function.at(r, 0)});
+    });
+    p.rule("function(e) :- entry(e)", {&entry}, {}, {&function}, [this](const RuleContext& ctx) {
+        const Range rows = ctx.delta(entry);
+        for (size_t r = rows.begin; r < rows.end; ++r)
+            function.insert({entry.at(r, 0)});
+    });
+    p.rule("function(t) :- scored_start(t)", {&scored_start}, {}, {&function}, [this](const RuleContext& ctx) {
+        const Range rows = ctx.delta(scored_start);
+        for (size_t r = rows.begin; r < rows.end; ++r)
+            function.insert({scored_start.at(r, 0)});
+    });
+    p.rule("function(s) :- seeded_start(s)", {&seeded_start}, {}, {&function}, [this](const RuleContext& ctx) {
+        const Range rows = ctx.delta(seeded_start);
+        for (size_t r = rows.begin; r < rows.end; ++r)
+            function.insert({seeded_start.at(r, 0)});
+    });
+    // Edges a -> b: code(b) :- code(a), edge(a, b).
+    for (Relation<2>* edge : {&fallthrough, &jump}) {
+        p.rule("code(b) :- code(a), " + edge->name() + "(a, b)", {&code, edge}, {}, {&code},
+               [this, edge](const RuleContext& ctx) {
+                   join(ctx, code, *edge, [&](size_t, size_t e) { code.insert({edge->at(e, 1)}); });
+               });
+    }
+    p.rule("function(t) :- code(a), call(a, t)", {&code, &call}, {}, {&function}, [this](const RuleContext& ctx) {
+        join(ctx, code, call, [&](size_t, size_t c) { function.insert({call.at(c, 1)}); });
+    });
+    // Code pointers: an immediate naming an instruction that starts right
+    // after a terminator (or its padding) is a function start where the ABI
+    // allows one, and otherwise the label of an indirect jump (a switch case)
+    // inside some function: code either way.
+    p.rule("function(t) | label(t) :- code(a), imm_ref(a, t), instr(t), boundary(t)", {&code, &imm_ref},
+           {&instr, &boundary}, {&function, &code, &label}, [this](const RuleContext& ctx) {
+               join(ctx, code, imm_ref, [&](size_t, size_t i) {
+                   const uint32_t target = imm_ref.at(i, 1);
+                   if (instr.contains({target}) && boundary.contains({target}))
+                       taken_address(target);
+               });
+           });
+    // Entries of candidate jump tables are left to the rule below, or
+    // released once no code jmp turned out to use them.
+    p.rule("function(t) | label(t) :- data_word(w, t), instr(t), boundary(t), !jump_table(w)",
+           {&data_word, &released_word}, {&instr, &boundary}, {&function, &code, &label},
+           [this](const RuleContext& ctx) {
+               const auto take = [&](const Relation<2>& words, Range rows, bool candidates) {
+                   for (size_t r = rows.begin; r < rows.end; ++r) {
+                       const uint32_t target = words.at(r, 1);
+                       if (instr.contains({target}) && boundary.contains({target})
+                           && !(candidates && table_candidates_.find(words.at(r, 0))))
+                           taken_address(target);
+                   }
+               };
+               take(data_word, ctx.delta(data_word), true);
+               take(released_word, ctx.delta(released_word), false);
+           });
+    // Tables of function pointers (find_pointer_runs): their entries start
+    // functions even where no terminator comes before them.
+    p.rule("function(t) | label(t) :- pointer_run(w, t)", {&pointer_run}, {}, {&function, &code, &label},
+           [this](const RuleContext& ctx) {
+               const Range rows = ctx.delta(pointer_run);
+               for (size_t r = rows.begin; r < rows.end; ++r)
+                   taken_address(pointer_run.at(r, 1));
+           });
+    // jmp *%reg leaves its function when reg holds an address at a boundary
+    // or a function pointer the callers pass in an argument register
+    // (french_tail_callback in tricky_part1.S); other literals are labels
+    // of the function, the targets of a computed jump.
+    p.rule("tail_call(j, t) | label(t) | arg_jump(e, reg, j) :- code(j), reg_jump(j, reg)", {&code, &reg_jump},
+           {&instr, &boundary}, {&tail_call, &code, &label, &arg_jump, &retrace}, [this](const RuleContext& ctx) {
+               join(ctx, code, reg_jump,
+                    [&](size_t r, size_t i) { trace_jump(code.at(r, 0), reg_jump.at(i, 1)); });
+           });
+    p.rule("tail_call(j, v) :- arg_jump(f, reg, j), code(c), call(c, f), reg = v at c", {&arg_jump, &code, &call},
+           {&caller}, {&tail_call, &retrace}, [this](const RuleContext& ctx) {
+               // New calls from code into the entries seen so far, then the
+               // callers of the new entries.
+               const size_t seen = ctx.seen(arg_jump).end;
+               join(ctx, code, call, [&](size_t r, size_t k) {
+                   arg_jump.for_key(call.at(k, 1), seen, [&](size_t g) { trace_argument(code.at(r, 0), g); });
+               });
+               const Range fresh = ctx.delta(arg_jump);
+               for (size_t g = fresh.begin; g < fresh.end; ++g)
+                   caller.for_key(arg_jump.at(g, 0), caller.size(), [&](size_t k) {
+                       const uint32_t c = caller.at(k, 1);
+                       if (code.contains({c}))
+                           trace_argument(c, g);
+                   });
+           });
+    // Code found later on a traced path may have made it a join or given it
+    // another start: both rules above trace again.
+    p.rule("trace again :- retrace(x, t), code(x)", {&code, &retrace, &arg_jump},
+           {&instr, &boundary, &reg_jump, &call}, {&tail_call, &code, &label, &arg_jump, &retrace},
+           [this](const RuleContext& ctx) {
+               join(ctx, code, retrace, [&](size_t, size_t w) {
+                   const uint32_t t = retrace.at(w, 1);
+                   reg_jump.for_key(t, reg_jump.size(), [&](size_t i) { trace_jump(t, reg_jump.at(i, 1)); });
+                   call.for_key(t, call.size(), [&](size_t k) {
+                       arg_jump.for_key(call.at(k, 1), arg_jump.size(), [&](size_t g) { trace_argument(t, g); });
+                   });
+               });
+           });
+    p.rule("function(t) | label(t) :- tail_call(j, t), instr(t)", {&tail_call}, {&instr},
+           {&function, &code, &label}, [this](const RuleContext& ctx) {
+               const Range rows = ctx.delta(tail_call);
+               for (size_t r = rows.begin; r < rows.end; ++r)
+                   if (instr.contains({tail_call.at(r, 1)}))
+                       taken_address(tail_call.at(r, 1));
+           });
+    // jmp rel32 across a function start to a boundary leaves its function
+    // (the stubs of func_jumptable jumping back to div in tricky_part1.S).
+    p.rule("far_jump(j, t) :- code(j), jmp(j, t), boundary(t)", {&code, &jump}, {&boundary}, {&far_jump},
+           [this](const RuleContext& ctx) {
+               join(ctx, code, jump, [&](size_t, size_t i) {
+                   const uint32_t j = jump.at(i, 0), t = jump.at(i, 1);
+                   if (text_.data.data()[j - text_.vaddr] == 0xE9 && boundary.contains({t}))
+                       far_jump.insert({j, t});
+               });
+           });
+    p.rule("function(t) | label(t) :- far_jump(j, t), function(f), f between j and t", {&far_jump, &function}, {},
+           {&function, &code, &label}, [this](const RuleContext& ctx) {
+               // Backward: a start in (t, j]; forward: one in (j, t).
+               const auto range = [&](size_t r) {
+                   const uint32_t j = far_jump.at(r, 0), t = far_jump.at(r, 1);
+                   return j < t ? std::pair(j + 1, t) : std::pair(t + 1, j + 1);
+               };
+               std::vector<uint32_t> crossed;
+               const Range fresh = ctx.delta(function);
+               for (size_t r = fresh.begin; r < fresh.end; ++r) {
+                   function_starts_.insert(function.at(r, 0));
+                   far_jump_ranges_.find_all(function.at(r, 0), crossed);
+               }
+               for (uint32_t i : crossed) {
+                   if (far_jump_rows_[i] != SIZE_MAX)
+                       taken_address(far_jump.at(far_jump_rows_[i], 1));
+                   far_jump_rows_[i] = SIZE_MAX;
+               }
+               const Range jumps = ctx.delta(far_jump);
+               for (size_t r = jumps.begin; r < jumps.end; ++r) {
+                   const auto [begin, end] = range(r);
+                   if (begin >= end)
+                       continue;
+                   if (const auto f = function_starts_.lower_bound(begin); f != function_starts_.end() && *f < end) {
+                       taken_address(far_jump.at(r, 1));
+                   } else {
+                       far_jump_ranges_.insert(begin, end);
+                       far_jump_rows_.push_back(r);
+                   }
+               }
+           });
+    // Switch tables: their entries are code of the function dispatching
+    // through them and edges of its jmp. The GOT-relative ones are only
+    // found once the GOT is known.
+    p.rule("code(t), label(t), table_target(j, t) :- code(j), indexed_jump(j, T), t in table T",
+           {&code, &indexed_jump, &got_indexed_jump, &got_setup}, {}, {&code, &label, &table_target, &table_word},
+           [this](const RuleContext& ctx) {
+               std::vector<TableJump> jumps;
+               join(ctx, code, indexed_jump, [&](size_t r, size_t i) {
+                   jumps.push_back({code.at(r, 0), indexed_jump.at(i, 1), 0});
+               });
+               settle_tables(jumps);
+               jumps.clear();
+               const auto got_jump = [&](size_t i) {
+                   jumps.push_back({got_indexed_jump.at(i, 0), table_got_ + got_indexed_jump.at(i, 1), table_got_});
+               };
+               if (table_got_) {
+                   join(ctx, code, got_indexed_jump, [&](size_t, size_t i) { got_jump(i); });
+               } else if (got_setup.size()) {
+                   table_got_ = got_setup.at(0, 2);
+                   std::vector<uint32_t> starts;
+                   for (uint32_t disp : got_indexed_jump.column(1))
+                       starts.push_back(table_got_ + disp);
+                   add_table_candidates(std::move(starts), table_got_);
+                   for (size_t i = 0; i < ctx.end(got_indexed_jump); ++i)
+                       if (code.contains({got_indexed_jump.at(i, 0)}))
+                           got_jump(i);
+               }
+               settle_tables(jumps);
+           });
+    // call __x86.get_pc_thunk.reg; add $_GLOBAL_OFFSET_TABLE_, %reg
+    p.rule("got_setup(s, reg, got) :- code(c), call(c, t), thunk(t, reg), got_add(s, reg, imm)",
+           {&code, &call}, {&thunk, &got_add}, {&got_setup}, [this](const RuleContext& ctx) {
+               join(ctx, code, call, [&](size_t r, size_t k) {
+                   const uint32_t c = code.at(r, 0);
+                   thunk.for_key(call.at(k, 1), thunk.size(), [&](size_t t) {
+                       const uint32_t reg = thunk.at(t, 1);
+                       got_add.for_key(c + 5, got_add.size(), [&](size_t g) {
+                           if (got_add.at(g, 1) == reg)
+                               got_setup.insert({c + 5, reg, c + 5 + got_add.at(g, 2)});
+                       });
+                   });
+               });
+           });
+    // call 1f; 1: pop %reg; add $_GLOBAL_OFFSET_TABLE_+(.-1b), %reg
+    p.rule("got_setup(s, reg, got) :- code(c), call_next(c, n), pop_reg(n, reg), got_add(s, reg, imm)",
+           {&code, &call_next}, {&pop_reg, &got_add}, {&got_setup}, [this](const RuleContext& ctx) {
+               join(ctx, code, call_next, [&](size_t, size_t k) {
+                   const uint32_t n = call_next.at(k, 1);
+                   pop_reg.for_key(n, pop_reg.size(), [&](size_t q) {
+                       const uint32_t reg = pop_reg.at(q, 1);
+                       got_add.for_key(n + 1, got_add.size(), [&](size_t g) {
+                           if (got_add.at(g, 1) == reg)
+                               got_setup.insert({n + 1, reg, n + got_add.at(g, 2)});
+                       });
+                   });
+               });
+           });
+
+    // Stratum 3: which function every instruction belongs to. Intra-procedural
+    // edges never enter another function's start.
+    p.stratum();
+    p.rule("member(f, f) :- function(f), code(f)", {&function}, {&code}, {&member}, [this](const RuleContext& ctx) {
+        const Range rows = ctx.delta(function);
+        for (size_t r = rows.begin; r < rows.end; ++r)
+            if (code.contains({function.at(r, 0)}))
+                member.insert({function.at(r, 0), function.at(r, 0)});
+    });
+    // Functions are contiguous, so a switch case belongs to the last
+    // function starting before it.
+    p.rule("member(l, f) :- label(l), f = max { function(f), f <= l }", {&label}, {&function, &code}, {&member},
+           [this](const RuleContext& ctx) {
+               std::vector<uint32_t> starts(function.column(0));
+               std::sort(starts.begin(), starts.end());
+               const Range rows = ctx.delta(label);
+               for (size_t r = rows.begin; r < rows.end; ++r) {
+                   const uint32_t l = label.at(r, 0);
+                   auto it = std::upper_bound(starts.begin(), starts.end(), l);
+                   if (it != starts.begin() && code.contains({*std::prev(it)}))
+                       member.insert({l, *std::prev(it)});
+               }
+           });
+    for (Relation<2>* edge : {&fallthrough, &jump, &table_target}) {
+        p.rule("member(b, f) :- member(a, f), " + edge->name() + "(a, b), !function(b)", {&member, edge},
+               {&function}, {&member}, [this, edge](const RuleContext& ctx) {
+                   join(ctx, member, *edge, [&](size_t m, size_t e) {
+                       const uint32_t b = edge->at(e, 1);
+                       if (!function.contains({b}))
+                           member.insert({b, member.at(m, 1)});
+                   });
+               });
+    }
+    // Functions reaching an undefined weak symbol, for the guard below.
+    p.rule("weak_caller(f) :- branch_zero(c), member(c, f)", {&branch_zero, &member}, {}, {&weak_caller},
+           [this](const RuleContext& ctx) {
+               join(ctx, branch_zero, member, [&](size_t, size_t m) { weak_caller.insert({member.at(m, 1)}); });
+           });
+
+    // Stratum 4: relocation candidates and data classification.
+    p.stratum();
+    // Where each GOT register set-up reaches, and the GOT32 and GOTOFF
+    // fields read through it; one task per function (see derive_got_bases).
+    p.rule("got_base(b, reg, got), reloc(s, GOT32|GOTOFF, got + d) :- got_setup(s, reg, got), ...",
+           {&got_setup, &fallthrough, &jump, &table_target, &tail_call, &call, &based_disp, &got_add},
+           {&function, &thunk}, {&got_base, &reloc}, [this](const RuleContext& ctx) {
+               if (any_changed(ctx, {&got_setup, &fallthrough, &jump, &table_target, &tail_call, &call, &based_disp,
+                                     &got_add}))
+                   derive_got_bases();
+           });
+    p.rule("reloc(w, type, t) :- table_word(w, t, type)", {&table_word}, {}, {&reloc}, [this](const RuleContext& ctx) {
+        const Range rows = ctx.delta(table_word);
+        for (size_t r = rows.begin; r < rows.end; ++r)
+            reloc.insert({table_word.at(r, 0), table_word.at(r, 2), table_word.at(r, 1)});
+    });
+    // The fields of code: GOTPC of the set-ups, PC32 of calls, of jumps
+    // leaving their function (tail calls; those within one are resolved by
+    // the assembler) and of branches to undefined weak symbols, 32 of
+    // immediates and displacements. One task per function.
+    p.rule("reloc(s, GOTPC|PC32|32, t) :- got_setup(a, r, t); code(a), call|jump|branch_zero|imm_ref|disp_ref(a, t)",
+           {&code, &got_setup, &call, &jump, &branch_zero, &imm_ref, &disp_ref}, {&member}, {&reloc},
+           [this](const RuleContext& ctx) { emit_code_relocs(ctx); });
+    // mov $weak_symbol, %reg; test %reg, %reg guarding a call to it.
+    p.rule("reloc(a + 1, 32, 0) :- mov0_test(a, reg), member(a, f), weak_caller(f)", {&mov0_test},
+           {&member, &weak_caller}, {&reloc}, [this](const RuleContext& ctx) {
+               const Range rows = ctx.delta(mov0_test);
+               for (size_t r = rows.begin; r < rows.end; ++r) {
+                   const uint32_t a = mov0_test.at(r, 0);
+                   member.for_key(a, member.size(), [&](size_t m) {
+                       if (weak_caller.contains({member.at(m, 1)}))
+                           reloc.insert({a + 1, R_386_32, 0});
+                   });
+               }
+           });
+    // Aligned words outside code and outside the GOT pointing into memory.
+    p.rule("reloc(w, 32, v) :- data_word(w, v), !code_byte(w), !got(w)", {&data_word}, {&code, &got_setup},
+           {&reloc}, [this](const RuleContext& ctx) {
+               uint32_t got = 0;
+               if (got_setup.size())
+                   got = got_setup.at(0, 2);
+               const uint32_t text_end = text_.vaddr + text_.filesz();
+               const Range rows = ctx.delta(data_word);
+               for (size_t r = rows.begin; r < rows.end; ++r) {
+                   const uint32_t w = data_word.at(r, 0);
+                   if (got && w >= got && w < text_end)
+                       continue;
+                   // Text does not hold pointers.
+                   const auto* run = string_run(w);
+                   if (run && run->second.confidence >= kConfidentString && string_run(w + 3) == run)
+                       continue;
+                   if (table_.contains(w) && (is_code_byte(w) || is_code_byte(w + 3)))
+                       continue;
+                   reloc.insert({w, R_386_32, data_word.at(r, 1)});
+               }
+           });
+}
+
+void Heuristics::evaluate()
+{
+    evaluations_ += program_.run();
+    release_tables();
+    evaluations_ += program_.run();
+}
+
+void Heuristics::release_tables()
+{
+    // Candidate tables no code jmp dispatches through are data like any
+    // other: what their words and the starts inside them say counts now.
+    for (size_t r = released_rows_; r < data_word.size(); ++r) {
+        const uint32_t w = data_word.at(r, 0);
+        if (table_candidates_.find(w) && !jump_tables_.find(w))
+            released_word.insert({w, data_word.at(r, 1)});
+    }
+    released_rows_ = data_word.size();
+    for (uint32_t addr : held_starts_)
+        if (!jump_tables_.find(addr))
+            scored_start.insert({addr});
+    held_starts_.clear();
+}
+
+Symbolization Heuristics::run()
+{
+    evaluate();
+    return partition(hypotheses().front());
+}
+
+std::vector<Heuristics::Hypothesis> Heuristics::hypotheses() const
+{
+    // The GOT of the first set-up idiom is the one the rules went on with;
+    // another one means some idiom was misread.
+    std::vector<uint32_t> gots;
+    for (size_t r = 0; r < got_setup.size(); ++r)
+        if (std::find(gots.begin(), gots.end(), got_setup.at(r, 2)) == gots.end())
+            gots.push_back(got_setup.at(r, 2));
+    if (gots.empty())
+        gots.push_back(0);
+
+    std::vector<Hypothesis> out;
+    for (uint32_t got : gots) {
+        out.push_back({got, true, true});
+        out.push_back({got, false, true});
+        out.push_back({got, true, false});
+    }
+    return out;
+}
+
+size_t Heuristics::match_signatures(const SignatureDb& db)
+{
+    if (db.empty())
+        return 0;
+    evaluate();
+
+    std::set<uint32_t> candidates;
+    for (size_t r = 0; r < function.size(); ++r)
+        candidates.insert(function.at(r, 0));
+    for (size_t r = 0; r < boundary.size(); ++r)
+        candidates.insert(boundary.at(r, 0));
+
+    // One pass of the index over the text finds every match; the candidates
+    // then only look theirs up.
+    const std::vector<SignatureDb::Hit> hits = db.find(text_.data);
+    size_t count = 0;
+    uint32_t matched_end = 0;
+    for (uint32_t addr : candidates) {
+        if (!table_.contains(addr) || addr < matched_end || !is_instr_.test(addr - table_.base))
+            continue;
+        const uint32_t offset = addr - table_.base;
+        auto hit = std::lower_bound(hits.begin(), hits.end(), offset,
+                                    [](const SignatureDb::Hit& h, uint32_t o) { return h.offset < o; });
+        if (hit == hits.end() || hit->offset != offset)
+            continue;
+        matched_end = addr + uint32_t(hit->signature->size());
+        apply_match(addr, *hit->signature);
+        ++count;
+    }
+    return count;
+}
+
+Symbolization Heuristics::partition(const Hypothesis& hypothesis) const
+{
+    Symbolization result;
+    const uint32_t text_end = text_.vaddr + text_.filesz();
+    if (hypothesis.got) {
+        result.got = hypothesis.got;
+        result.got_end = text_end;
+    }
+    const uint32_t flash_end = result.got && result.got >= text_.vaddr && result.got < text_end ? result.got : text_end;
+    const auto in_got = [&](uint32_t addr) { return result.got && addr >= result.got && addr < result.got_end; };
+
+    // Inside a function matched by a signature, the signature's relocations
+    // are the only ones: absolute and PC-relative fields are taken from it,
+    // GOT-relative ones still need the heuristics for their target.
+    std::map<uint32_t, uint32_t> matched_ranges;
+    for (size_t r = 0; r < matched.size(); ++r)
+        matched_ranges.emplace(matched.at(r, 0), matched.at(r, 1));
+    std::map<uint32_t, uint32_t> signature_type;
+    for (size_t r = 0; r < sig_reloc.size(); ++r)
+        signature_type.emplace(sig_reloc.at(r, 0), sig_reloc.at(r, 1));
+    const auto in_match = [&](uint32_t addr) {
+        auto it = matched_ranges.upper_bound(addr);
+        return it != matched_ranges.begin() && addr < std::prev(it)->second;
+    };
+
+    // One relocation per site; GOT-relative readings win over absolute ones.
+    std::map<uint32_t, Relocation> by_site;
+    const auto rank = [](uint32_t type) { return type == R_386_32 ? 0 : 1; };
+    for (size_t r = 0; r < reloc.size(); ++r) {
+        const Relocation rel{reloc.at(r, 0), reloc.at(r, 1), reloc.at(r, 2)};
+        if (in_got(rel.site) || (rel.type == R_386_GOTPC && rel.target != result.got))
+            continue;
+        if (in_match(rel.site)) {
+            auto it = signature_type.find(rel.site);
+            if (it == signature_type.end() || it->second != rel.type)
+                continue;
+        }
+        auto [it, inserted] = by_site.emplace(rel.site, rel);
+        if (!inserted && (rank(rel.type) > rank(it->second.type)
+                          || (rank(rel.type) == rank(it->second.type) && rel.target < it->second.target)))
+            it->second = rel;
+    }
+    for (size_t r = 0; r < sig_reloc.size(); ++r) {
+        const Relocation rel{sig_reloc.at(r, 0), sig_reloc.at(r, 1), sig_reloc.at(r, 2)};
+        if (rel.type == R_386_32 || rel.type == R_386_PC32)
+            by_site[rel.site] = rel;
+    }
+
+    // Object starts: functions, referenced data and the segment starts.
+    std::set<uint32_t> functions;
+    for (size_t r = 0; r < function.size(); ++r) {
+        const uint32_t f = function.at(r, 0);
+        if (f >= text_.vaddr && f < flash_end && code.contains({f}))
+            functions.insert(f);
+    }
+    std::set<uint32_t> starts(functions.begin(), functions.end());
+    for (const auto& [site, rel] : by_site) {
+        if (rel.type != R_386_32 && rel.type != R_386_GOTOFF)
+            continue;
+        if (table_.contains(rel.target)
+            && (code.contains({rel.target}) || is_code_byte(rel.target) || in_match(rel.target)))
+            continue;
+        starts.insert(rel.target);
+    }
+    if (!hypothesis.starts_in_fields) {
+        for (const auto& [site, rel] : by_site)
+            for (auto it = starts.upper_bound(site); it != starts.end() && *it < site + 4;)
+                it = functions.count(*it) ? std::next(it) : starts.erase(it);
+    }
+
+    const auto add_objects = [&](uint32_t begin, uint32_t end, ObjectKind kind) {
+        if (begin >= end)
+            return;
+        std::vector<uint32_t> cuts{begin};
+        for (auto it = starts.upper_bound(begin); it != starts.end() && *it < end; ++it)
+            cuts.push_back(*it);
+        cuts.push_back(end);
+        for (size_t i = 0; i + 1 < cuts.size(); ++i) {
+            ObjectKind k = kind;
+            if (kind == ObjectKind::Function && !functions.count(cuts[i]))
+                k = ObjectKind::ReadOnly;
+            result.objects.push_back({cuts[i], cuts[i + 1] - cuts[i], k});
+        }
+    };
+
+    add_objects(text_.vaddr, flash_end, ObjectKind::Function);
+    for (const Segment& seg : image_.segments) {
+        if (&seg == &text_ || !seg.writable() || seg.vaddr - kRamOrigin >= kRamSize)
+            continue;
+        add_objects(seg.vaddr, seg.vaddr + seg.filesz(), ObjectKind::Data);
+        if (seg.memsz == seg.filesz())
+            continue;
+
+        // .bss is followed by .heap and .stack, which the linker script
+        // re-creates: it ends before the stack of the unpatched script, or
+        // after the last variable referenced.
+        const uint32_t bss_begin = seg.vaddr + seg.filesz();
+        uint32_t bss_end = bss_begin;
+        if (seg.end() < kRamOrigin + kRamSize && seg.memsz - seg.filesz() >= kDefaultStackSize) {
+            bss_end = seg.end() - kDefaultStackSize;
+        } else {
+            for (auto it = starts.lower_bound(bss_begin); it != starts.end() && *it < seg.end(); ++it)
+                bss_end = std::max(bss_end, *it + 4);
+            bss_end = (bss_end + 7) & ~7u;
+        }
+        add_objects(bss_begin, std::min(bss_end, seg.end()), ObjectKind::Bss);
+    }
+    std::sort(result.objects.begin(), result.objects.end(),
+              [](const Object& a, const Object& b) { return a.addr < b.addr; });
+
+    for (const auto& [site, rel] : by_site) {
+        const Object* obj = result.object_at(site);
+        if (obj && (hypothesis.straddling_literals || rel.type != R_386_32 || obj->end() - site >= 4))
+            result.relocations.push_back(rel);
+    }
+    return result;
+}
+
+} // namespace symbolize
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+
+#include "bitset.h"
+#include "cfg.h"
+#include "datalog.h"
+#include "image.h"
+#include "interval_tree.h"
+#include "pointer_scan.h"
+#include "signatures.h"
+#include "string_scan.h"
+#include "superset.h"
+#include "symbolization.h"
+
+namespace symbolize {
+
+// An object of an earlier revision (FunctionCache) found again in the input.
+struct ReusedObject {
+    uint32_t addr = 0;
+    const Signature* signature = nullptr;
+    ObjectKind kind = ObjectKind::Function;
+};
+
+// What Heuristics::find_reused() found, and what the passes before the
+// heuristics may skip of it: build_superset does not decode the `undecoded`
+// offsets, build_cfg leaves the `skipped` ones out.
+struct ReusedObjects {
+    std::vector<ReusedObject> objects; // by address
+    Bitset undecoded; // inside reused functions, starting none of their instructions
+    Bitset skipped;   // past the start of reused functions taken over whole
+};
+
+// The recovery heuristics of the statement written as Datalog rules over facts
+// extracted from the superset table (the approach of the Datalog Disassembly
+// paper). Facts and rules can be added after a run; the next run() only
+// evaluates what they affect.
+class Heuristics {
+public:
+    template <size_t N>
+    using Relation = datalog::Relation<N>;
+
+    // `reused` are objects recovered from earlier revisions: their extent
+    // and relocations are taken over, and their bytes yield no facts beyond
+    // a function's start. `threads` run the per-function passes.
+    Heuristics(const Image& image, const SupersetTable& table, const Bitset& is_instr, const Cfg& cfg,
+               const ReusedObjects* reused = nullptr, unsigned threads = 1);
+
+    // The objects of `known` that reappear in `image`. Runs before the
+    // superset is built, on the bytes alone.
+    static ReusedObjects find_reused(const Image& image, const SignatureDb& known);
+
+    // A reading of what the rules leave open. The GOT is the one of the
+    // set-up idioms found; a relocated field that an object start falls in
+    // is either no pointer (a literal) or the start is wrong.
+    struct Hypothesis {
+        uint32_t got = 0;                 // _GLOBAL_OFFSET_TABLE_, 0 if none
+        bool starts_in_fields = true;     // keep object starts inside relocated fields
+        bool straddling_literals = true;  // keep absolute fields an object start falls in
+    };
+
+    // Evaluates the rules and partitions the segments into objects by the
+    // likeliest hypothesis.
+    Symbolization run();
+
+    // Every hypothesis after run(), likeliest first; partition() builds the
+    // objects and relocations of one.
+    std::vector<Hypothesis> hypotheses() const;
+    Symbolization partition(const Hypothesis& hypothesis) const;
+
+    // Function starts established by other passes.
+    void add_function(uint32_t addr) { seeded_start.insert({addr}); }
+
+    // Compares the function starts and boundaries derived so far against
+    // library signatures. A match fixes the function's extent and its
+    // relocations. Returns the number of functions matched.
+    size_t match_signatures(const SignatureDb& db);
+
+    // Recovered objects as signatures for FunctionCache, relocation fields
+    // masked: functions up to their last instruction, named x<addr>f, and
+    // data holding pointers, x<addr>r or x<addr>d after their section.
+    std::vector<Signature> object_signatures(const Symbolization& result) const;
+
+    size_t reused_functions() const { return reused_functions_; }
+    size_t reused_data() const { return reused_data_; }
+
+    // String literals of every segment, by address.
+    const std::map<uint32_t, StringLiteral>& strings() const { return strings_; }
+
+    datalog::Program& program() { return program_; }
+    size_t evaluations() const { return evaluations_; }
+
+    // Input facts, one row per candidate instruction (addresses, not offsets).
+    Relation<1> instr{"instr"};
+    Relation<1> entry{"entry"};
+    Relation<2> fallthrough{"fallthrough"};   // (insn, next)
+    Relation<2> jump{"jump"};                 // (insn, target): jmp and jcc
+    Relation<2> call{"call"};                 // (insn, target), not the call/pop idiom
+    Relation<2> caller{"caller"};             // (target, insn): call by its target
+    Relation<2> call_next{"call_next"};       // (insn, next): call to the next instruction
+    Relation<1> branch_zero{"branch_zero"};   // call/jmp to an undefined weak symbol
+    Relation<2> imm_ref{"imm_ref"};           // (insn, imm32 inside a memory window)
+    Relation<2> disp_ref{"disp_ref"};         // (insn, absolute disp32 inside a window)
+    Relation<3> based_disp{"based_disp"};     // (insn, base register, disp32)
+    Relation<2> thunk{"thunk"};               // (function, reg): mov (%esp),%reg; ret
+    Relation<3> got_add{"got_add"};           // (insn, reg, imm): add $imm32,%reg
+    Relation<2> pop_reg{"pop_reg"};           // (insn, reg)
+    Relation<2> mov0_test{"mov0_test"};       // (insn, reg): mov $0,%reg; test %reg,%reg
+    Relation<1> boundary{"boundary"};         // right after ret/jmp/trap
+    Relation<2> padding{"padding"};           // (insn, next) for nop-like padding
+    Relation<2> data_word{"data_word"};       // (addr, value) aligned words pointing into a window
+    Relation<2> pointer_run{"pointer_run"};   // (addr, function) data_word rows of a table of function pointers
+    Relation<2> released_word{"released_word"}; // (addr, value) data_word rows of tables no code jmp uses
+    Relation<2> indexed_jump{"indexed_jump"}; // (jmp, table): jmp *table(,%i,4) or the same through a register
+    Relation<2> got_indexed_jump{"got_indexed_jump"}; // (jmp, disp): the table at GOT + disp holds GOT offsets
+    Relation<2> reg_jump{"reg_jump"};         // (jmp, reg): jmp *%reg
+    Relation<2> matched{"matched"};           // (begin, end) of a function matched by a signature or reused
+    Relation<3> sig_reloc{"sig_reloc"};       // (site, type, target) from a signature; target 0 if not 32/PC32
+    Relation<1> scored_start{"scored_start"}; // enough evidence of a function start (score_function_starts)
+    Relation<1> seeded_start{"seeded_start"}; // function start from a signature or a reused object (add_function)
+
+    // Derived facts.
+    Relation<1> code{"code"};
+    Relation<1> function{"function"};
+    Relation<1> label{"label"};               // taken code address inside a function (a switch case)
+    Relation<3> got_setup{"got_setup"};       // (add insn, reg, GOT address)
+    Relation<2> table_target{"table_target"}; // (jmp, case): an entry of the jump table of a code jmp
+    Relation<2> far_jump{"far_jump"};         // (jmp, boundary): code jmp rel32 to a boundary
+    Relation<3> arg_jump{"arg_jump"};         // (entry, reg, jmp): jmp *%reg, reg as the code path from entry got it
+    Relation<2> retrace{"retrace"};           // (insn, traced): trace_register from traced met insn, no code yet
+    Relation<2> tail_call{"tail_call"};       // (jmp, function): jmp *%reg leaving its function
+    Relation<3> table_word{"table_word"};     // (entry address, case, relocation type)
+    Relation<2> member{"member"};             // (insn, function)
+    Relation<1> weak_caller{"weak_caller"};   // function reaching an undefined weak symbol
+    Relation<3> got_base{"got_base"};         // (insn, reg, GOT address): reg holds the GOT when insn runs
+    Relation<3> reloc{"reloc"};               // (site, type, target)
+
+private:
+    // What a register holds when an instruction runs, as far as the code
+    // path leading to it tells.
+    struct RegisterValue {
+        enum Kind : uint8_t { Unknown, Literal, Incoming } kind = Unknown;
+        uint32_t value = 0; // the literal, or the register at `entry`
+        uint32_t entry = 0; // Incoming: where the path starts
+    };
+
+    // What following the GOT registers through one function found.
+    struct GotFacts {
+        std::vector<Relation<3>::Tuple> bases;   // got_base rows
+        std::vector<Relation<3>::Tuple> relocs;  // GOT32 and GOTOFF candidates
+        std::vector<std::pair<uint32_t, uint32_t>> callees; // (function, GOT) called with the GOT in %ebx
+    };
+
+    // A code jmp through a table, and how far the table may extend as far as
+    // the jmp alone tells (settle_tables).
+    struct TableJump {
+        uint32_t jmp = 0;
+        uint32_t table = 0;
+        uint32_t bias = 0;   // GOT for GOT-relative entries
+        uint64_t limit = 0;  // the bound the index is checked against, or the next candidate table
+        uint32_t end = 0;    // entries up to limit pointing at candidate instructions
+    };
+
+    void reuse_objects(const ReusedObjects& reused);
+    bool immediate_field(uint32_t site) const;
+    void apply_match(uint32_t addr, const Signature& sig);
+    void extract_facts();
+    void propagate_unsaved_reads();
+    void find_pointer_runs();
+    void score_function_starts();
+    void taken_address(uint32_t addr);
+    void find_indexed_jump(size_t offset, const Instruction& insn);
+    void add_table_candidates(std::vector<uint32_t> starts, uint32_t bias);
+    uint64_t table_limit(uint32_t begin, uint64_t limit, const IntervalTree* known) const;
+    uint32_t table_end(uint32_t begin, uint64_t limit, uint32_t bias) const;
+    uint32_t table_bound(uint32_t jmp) const;
+    void settle_tables(std::vector<TableJump>& jumps);
+    void follow_table(const TableJump& jump);
+    uint32_t owner(uint32_t addr) const;
+    void emit_code_relocs(const datalog::RuleContext& ctx);
+    void add_rules();
+    void evaluate();
+    void release_tables();
+    bool is_code_byte(uint32_t addr) const;
+    RegisterValue trace_register(uint32_t addr, uint32_t reg, std::vector<uint32_t>& pending) const;
+    void trace_jump(uint32_t jmp, uint32_t reg);
+    void trace_argument(uint32_t call_insn, size_t arg_row);
+    const std::pair<const uint32_t, StringLiteral>* string_run(uint32_t addr) const;
+    bool clobbered_by_thunk(uint32_t insn, uint32_t reg) const;
+    void follow_got(const std::vector<Relation<3>::Tuple>& seeds, GotFacts& facts) const;
+    void derive_got_bases();
+    std::vector<AddressWindow> pointer_windows() const;
+
+    const Image& image_;
+    const SupersetTable& table_;
+    const Bitset& is_instr_;
+    const Cfg& cfg_;
+    const Segment& text_;
+    datalog::Program program_;
+    size_t evaluations_ = 0;
+    size_t reused_functions_ = 0;
+    size_t reused_data_ = 0;
+    unsigned threads_;
+    Bitset reused_;           // ReusedObjects::skipped
+    std::vector<std::pair<uint32_t, uint32_t>> reused_ranges_; // [begin, end) of reused objects, sorted
+    std::vector<uint8_t> writes_; // written_registers() of the instruction at every offset
+    // Per offset, the non-argument registers some path from it reads before
+    // writing or saving them; a function cannot start where this is not 0.
+    std::vector<uint8_t> unsaved_reads_;
+    std::vector<uint8_t> saves_;  // writes_ plus the registers pushed
+    // Candidate jump tables: the absolute ones of every candidate jmp, then
+    // the GOT relative ones once the GOT (table_got_) is known. Only those
+    // of code jmps become jump_tables_; starts scored inside the others wait
+    // for the fixpoint in held_starts_.
+    IntervalTree table_candidates_;
+    std::vector<uint32_t> table_starts_;
+    IntervalTree jump_tables_;
+    std::vector<uint32_t> held_starts_;
+    size_t released_rows_ = 0; // data_word rows release_tables went through
+    std::set<uint32_t> function_starts_; // function rows, sorted
+    // far_jump rows crossing no function start yet, by the range a start
+    // must fall in; far_jump_rows_ maps the ranks of its intervals to rows
+    // (SIZE_MAX once one does).
+    IntervalTree far_jump_ranges_;
+    std::vector<size_t> far_jump_rows_;
+    std::map<uint32_t, StringLiteral> strings_;
+    uint32_t table_got_ = 0;
+};
+
+} // namespace symbolize
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <elf.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "mapped_file.h"
+#include "span.h"
+
+namespace symbolize {
+
+// The flash and RAM windows from the MEMORY block of picolibc.ld.
+constexpr uint32_t kFlashOrigin = 0x40030000;
+constexpr uint32_t kFlashSize = 192 * 1024;
+constexpr uint32_t kRamOrigin = 0xA800A000;
+constexpr uint32_t kRamSize = 40 * 1024;
+
+// One PT_LOAD of the input. `data` views its file bytes, owned by the Image,
+// straight into the mapped input file.
+struct Segment {
+    uint32_t vaddr = 0;
+    uint32_t paddr = 0;
+    uint32_t memsz = 0;
+    uint32_t flags = 0; // PF_R | PF_W | PF_X
+    Span<uint8_t> data;
+
+    uint32_t filesz() const { return uint32_t(data.size()); }
+    bool executable() const { return flags & 1; }
+    bool writable() const { return flags & 2; }
+    bool contains(uint32_t addr) const { return addr - vaddr < memsz; }
+    uint32_t end() const { return vaddr + memsz; }
+};
+
+// Everything that survived `llvm-objcopy --strip-all --strip-sections`.
+struct Image {
+    uint32_t entry = 0;
+    uint16_t machine = 0;
+    std::vector<Segment> segments;
+    Span<Elf32_Phdr> program_headers; // all of them, inside `file`
+    MappedFile file;
+    std::vector<uint8_t> storage;     // bytes of images not backed by a file
+    bool flash_image = false;         // a raw flash image, see flash_input.h
+
+    // The PT_LOAD holding the code (flash at 0x40030000 for our linker script).
+    const Segment* text_segment() const
+    {
+        for (const Segment& seg : segments)
+            if (seg.executable() && seg.filesz())
+                return &seg;
+        return nullptr;
+    }
+
+    const Segment* segment_at(uint32_t addr) const
+    {
+        for (const Segment& seg : segments)
+            if (seg.memsz && seg.contains(addr))
+                return &seg;
+        return nullptr;
+    }
+};
+
+} // namespace symbolize
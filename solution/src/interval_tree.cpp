@@ -0,0 +1,104 @@
+#include "interval_tree.h"
+
+#include <algorithm>
+
+namespace symbolize {
+
+void IntervalTree::insert(uint32_t begin, uint32_t end)
+{
+    if (begin >= end)
+        return;
+    // Priorities from a hash of the insertion count keep the shape, and so
+    // the answers of find_overlap, the same from run to run.
+    const uint32_t fresh = uint32_t(nodes_.size());
+    nodes_.push_back({{begin, end}, end, (fresh + 1) * 0x9E3779B9u});
+    root_ = insert_below(root_, fresh);
+}
+
+uint32_t IntervalTree::insert_below(uint32_t node, uint32_t fresh)
+{
+    if (node == kNil)
+        return fresh;
+    if (nodes_[fresh].interval.begin < nodes_[node].interval.begin) {
+        nodes_[node].left = insert_below(nodes_[node].left, fresh);
+        if (nodes_[nodes_[node].left].priority > nodes_[node].priority)
+            return rotate_right(node);
+    } else {
+        nodes_[node].right = insert_below(nodes_[node].right, fresh);
+        if (nodes_[nodes_[node].right].priority > nodes_[node].priority)
+            return rotate_left(node);
+    }
+    update(node);
+    return node;
+}
+
+uint32_t IntervalTree::rotate_right(uint32_t node)
+{
+    const uint32_t pivot = nodes_[node].left;
+    nodes_[node].left = nodes_[pivot].right;
+    nodes_[pivot].right = node;
+    update(node);
+    update(pivot);
+    return pivot;
+}
+
+uint32_t IntervalTree::rotate_left(uint32_t node)
+{
+    const uint32_t pivot = nodes_[node].right;
+    nodes_[node].right = nodes_[pivot].left;
+    nodes_[pivot].left = node;
+    update(node);
+    update(pivot);
+    return pivot;
+}
+
+void IntervalTree::update(uint32_t node)
+{
+    Node& n = nodes_[node];
+    n.max_end = std::max({n.interval.end, max_end(n.left), max_end(n.right)});
+}
+
+const IntervalTree::Interval* IntervalTree::find_overlap(uint32_t begin, uint32_t end) const
+{
+    // Leftmost first: a left subtree reaching past `begin` holds the answer
+    // if there is one, since all its intervals start before the node's.
+    for (uint32_t node = root_; node != kNil;) {
+        const Node& n = nodes_[node];
+        if (max_end(n.left) > begin) {
+            node = n.left;
+            continue;
+        }
+        if (n.interval.begin >= end)
+            return nullptr;
+        if (n.interval.end > begin)
+            return &n.interval;
+        node = n.right;
+    }
+    return nullptr;
+}
+
+void IntervalTree::find_all(uint32_t addr, std::vector<uint32_t>& found) const
+{
+    // Nodes are stored in insertion order; subtrees ending at or before addr
+    // and right subtrees of nodes starting after it hold none.
+    std::vector<uint32_t> stack;
+    if (root_ != kNil)
+        stack.push_back(root_);
+    while (!stack.empty()) {
+        const uint32_t node = stack.back();
+        stack.pop_back();
+        const Node& n = nodes_[node];
+        if (n.max_end <= addr)
+            continue;
+        if (n.left != kNil)
+            stack.push_back(n.left);
+        if (n.interval.begin > addr)
+            continue;
+        if (n.interval.end > addr)
+            found.push_back(node);
+        if (n.right != kNil)
+            stack.push_back(n.right);
+    }
+}
+
+} // namespace symbolize
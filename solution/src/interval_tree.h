@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace symbolize {
+
+// Half-open address intervals [begin, end) in a treap ordered by begin, every
+// node also keeping the largest end below it; inserting and finding an
+// interval that overlaps a range take O(log n) whatever the order in which
+// the intervals come. Intervals may overlap one another.
+class IntervalTree {
+public:
+    struct Interval {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    size_t size() const { return nodes_.size(); }
+    bool empty() const { return nodes_.empty(); }
+
+    // Empty intervals are not stored.
+    void insert(uint32_t begin, uint32_t end);
+
+    // An interval overlapping [begin, end), the one starting first if
+    // several do; nullptr if none does.
+    const Interval* find_overlap(uint32_t begin, uint32_t end) const;
+
+    // The interval containing addr that starts first, or nullptr.
+    const Interval* find(uint32_t addr) const { return find_overlap(addr, addr + 1); }
+
+    // Appends to `found` the rank, in insertion order among the intervals
+    // stored, of every interval containing addr.
+    void find_all(uint32_t addr, std::vector<uint32_t>& found) const;
+
+private:
+    static constexpr uint32_t kNil = UINT32_MAX;
+
+    struct Node {
+        Interval interval;
+        uint32_t max_end;
+        uint32_t priority;
+        uint32_t left = kNil;
+        uint32_t right = kNil;
+    };
+
+    uint32_t insert_below(uint32_t node, uint32_t fresh);
+    uint32_t rotate_right(uint32_t node);
+    uint32_t rotate_left(uint32_t node);
+    void update(uint32_t node);
+    uint32_t max_end(uint32_t node) const { return node == kNil ? 0 : nodes_[node].max_end; }
+
+    std::vector<Node> nodes_;
+    uint32_t root_ = kNil;
+};
+
+} // namespace symbolize
@@ -0,0 +1,228 @@
+#include "length_simd.h"
+
+#include "decoder.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SYMBOLIZE_X86_SIMD 1
+#endif
+
+namespace symbolize {
+
+namespace {
+
+// Longest encoding the fast path accepts: opcode, ModRM, SIB, disp32, imm32.
+constexpr size_t kMaxSimpleLength = 11;
+// Bytes that must be readable past an offset: the longest simple encoding
+// and the three bytes the classifier loads.
+constexpr size_t kLookahead = 16;
+
+// One byte per opcode: 0 for invalid, kLutDecoder for the full decoder,
+// otherwise 1 + immediate size in bits 0-2, kLutModrm and kLutImm32.
+constexpr uint8_t kLutModrm = 0x08;
+constexpr uint8_t kLutImm32 = 0x10;
+constexpr uint8_t kLutDecoder = 0x80;
+
+struct OpcodeLut {
+    alignas(32) uint8_t bytes[256];
+
+    OpcodeLut()
+    {
+        for (unsigned opcode = 0; opcode < 256; ++opcode) {
+            const OpcodeShape shape = one_byte_shape(uint8_t(opcode));
+            const bool escape = opcode == 0x0F || opcode == 0x66 || opcode == 0x67
+                || opcode == 0xF0 || opcode == 0xF2 || opcode == 0xF3;
+            uint8_t entry = 0;
+            if (escape || (shape.valid && (shape.flow != Flow::Sequential || shape.modrm_dependent || shape.moffs)))
+                entry = kLutDecoder;
+            else if (shape.valid)
+                entry = uint8_t((1 + shape.imm_size) | (shape.modrm ? kLutModrm : 0)
+                                | (shape.imm_size == 4 ? kLutImm32 : 0));
+            bytes[opcode] = entry;
+        }
+    }
+};
+
+const OpcodeLut& opcode_lut()
+{
+    static const OpcodeLut lut;
+    return lut;
+}
+
+#ifdef SYMBOLIZE_X86_SIMD
+
+// Same computation as classify_lengths_scalar(), on 16 offsets per step.
+// The 256-entry table is looked up with one PSHUFB per high nibble.
+__attribute__((target("sse4.1"))) size_t classify_sse41(const uint8_t* code, size_t size,
+                                                         uint8_t* length, uint8_t* flags)
+{
+    const uint8_t* lut = opcode_lut().bytes;
+    __m128i rows[16];
+    for (int r = 0; r < 16; ++r)
+        rows[r] = _mm_load_si128(reinterpret_cast<const __m128i*>(lut + 16 * r));
+
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 + kLookahead <= size; i += 16) {
+        const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code + i));
+        const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code + i + 1));
+        const __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code + i + 2));
+
+        const __m128i lo = _mm_and_si128(b0, nibble);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(b0, 4), nibble);
+        __m128i entry = zero;
+        for (int r = 0; r < 16; ++r) {
+            const __m128i row_hit = _mm_cmpeq_epi8(hi, _mm_set1_epi8(char(r)));
+            entry = _mm_or_si128(entry, _mm_and_si128(row_hit, _mm_shuffle_epi8(rows[r], lo)));
+        }
+
+        const __m128i mod = _mm_and_si128(b1, _mm_set1_epi8(char(0xC0)));
+        const __m128i rm = _mm_and_si128(b1, _mm_set1_epi8(7));
+        const __m128i base = _mm_and_si128(b2, _mm_set1_epi8(7));
+        const __m128i mod0 = _mm_cmpeq_epi8(mod, zero);
+        const __m128i mod1 = _mm_cmpeq_epi8(mod, _mm_set1_epi8(0x40));
+        const __m128i mod2 = _mm_cmpeq_epi8(mod, _mm_set1_epi8(char(0x80)));
+        const __m128i mod3 = _mm_cmpeq_epi8(mod, _mm_set1_epi8(char(0xC0)));
+        const __m128i sib = _mm_andnot_si128(mod3, _mm_cmpeq_epi8(rm, _mm_set1_epi8(4)));
+        const __m128i disp32 = _mm_or_si128(
+            mod2, _mm_and_si128(mod0, _mm_or_si128(_mm_cmpeq_epi8(rm, _mm_set1_epi8(5)),
+                                                    _mm_and_si128(sib, _mm_cmpeq_epi8(base, _mm_set1_epi8(5))))));
+
+        __m128i extra = _mm_set1_epi8(1);
+        extra = _mm_add_epi8(extra, _mm_and_si128(sib, _mm_set1_epi8(1)));
+        extra = _mm_add_epi8(extra, _mm_and_si128(mod1, _mm_set1_epi8(1)));
+        extra = _mm_add_epi8(extra, _mm_and_si128(disp32, _mm_set1_epi8(4)));
+
+        const __m128i has_modrm = _mm_cmpeq_epi8(_mm_and_si128(entry, _mm_set1_epi8(kLutModrm)),
+                                                 _mm_set1_epi8(kLutModrm));
+        const __m128i decoder = _mm_cmpeq_epi8(_mm_and_si128(entry, _mm_set1_epi8(char(kLutDecoder))),
+                                               _mm_set1_epi8(char(kLutDecoder)));
+        __m128i len = _mm_add_epi8(_mm_and_si128(entry, _mm_set1_epi8(7)), _mm_and_si128(has_modrm, extra));
+        len = _mm_andnot_si128(decoder, len);
+
+        __m128i fl = _mm_and_si128(has_modrm, _mm_or_si128(_mm_and_si128(disp32, _mm_set1_epi8(kDisp32)),
+                                                           _mm_and_si128(sib, _mm_set1_epi8(kSib))));
+        fl = _mm_or_si128(fl, _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(entry, _mm_set1_epi8(kLutImm32)),
+                                                           _mm_set1_epi8(kLutImm32)),
+                                            _mm_set1_epi8(kImm32)));
+        fl = _mm_blendv_epi8(fl, _mm_set1_epi8(char(kNeedsDecoder)), decoder);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(length + i), len);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(flags + i), fl);
+    }
+    return i;
+}
+
+// The SSE4.1 pass widened to 32 offsets; PSHUFB works per 128-bit lane, so
+// every table row is broadcast to both lanes.
+__attribute__((target("avx2"))) size_t classify_avx2(const uint8_t* code, size_t size,
+                                                      uint8_t* length, uint8_t* flags)
+{
+    const uint8_t* lut = opcode_lut().bytes;
+    __m256i rows[16];
+    for (int r = 0; r < 16; ++r)
+        rows[r] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(lut + 16 * r)));
+
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 + kLookahead <= size; i += 32) {
+        const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(code + i));
+        const __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(code + i + 1));
+        const __m256i b2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(code + i + 2));
+
+        const __m256i lo = _mm256_and_si256(b0, nibble);
+        const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(b0, 4), nibble);
+        __m256i entry = zero;
+        for (int r = 0; r < 16; ++r) {
+            const __m256i row_hit = _mm256_cmpeq_epi8(hi, _mm256_set1_epi8(char(r)));
+            entry = _mm256_or_si256(entry, _mm256_and_si256(row_hit, _mm256_shuffle_epi8(rows[r], lo)));
+        }
+
+        const __m256i mod = _mm256_and_si256(b1, _mm256_set1_epi8(char(0xC0)));
+        const __m256i rm = _mm256_and_si256(b1, _mm256_set1_epi8(7));
+        const __m256i base = _mm256_and_si256(b2, _mm256_set1_epi8(7));
+        const __m256i mod0 = _mm256_cmpeq_epi8(mod, zero);
+        const __m256i mod1 = _mm256_cmpeq_epi8(mod, _mm256_set1_epi8(0x40));
+        const __m256i mod2 = _mm256_cmpeq_epi8(mod, _mm256_set1_epi8(char(0x80)));
+        const __m256i mod3 = _mm256_cmpeq_epi8(mod, _mm256_set1_epi8(char(0xC0)));
+        const __m256i sib = _mm256_andnot_si256(mod3, _mm256_cmpeq_epi8(rm, _mm256_set1_epi8(4)));
+        const __m256i disp32 = _mm256_or_si256(
+            mod2, _mm256_and_si256(mod0, _mm256_or_si256(_mm256_cmpeq_epi8(rm, _mm256_set1_epi8(5)),
+                                                          _mm256_and_si256(sib, _mm256_cmpeq_epi8(base, _mm256_set1_epi8(5))))));
+
+        __m256i extra = _mm256_set1_epi8(1);
+        extra = _mm256_add_epi8(extra, _mm256_and_si256(sib, _mm256_set1_epi8(1)));
+        extra = _mm256_add_epi8(extra, _mm256_and_si256(mod1, _mm256_set1_epi8(1)));
+        extra = _mm256_add_epi8(extra, _mm256_and_si256(disp32, _mm256_set1_epi8(4)));
+
+        const __m256i has_modrm = _mm256_cmpeq_epi8(_mm256_and_si256(entry, _mm256_set1_epi8(kLutModrm)),
+                                                    _mm256_set1_epi8(kLutModrm));
+        const __m256i decoder = _mm256_cmpeq_epi8(_mm256_and_si256(entry, _mm256_set1_epi8(char(kLutDecoder))),
+                                                  _mm256_set1_epi8(char(kLutDecoder)));
+        __m256i len = _mm256_add_epi8(_mm256_and_si256(entry, _mm256_set1_epi8(7)),
+                                      _mm256_and_si256(has_modrm, extra));
+        len = _mm256_andnot_si256(decoder, len);
+
+        __m256i fl = _mm256_and_si256(has_modrm,
+                                      _mm256_or_si256(_mm256_and_si256(disp32, _mm256_set1_epi8(kDisp32)),
+                                                      _mm256_and_si256(sib, _mm256_set1_epi8(kSib))));
+        fl = _mm256_or_si256(fl, _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(entry, _mm256_set1_epi8(kLutImm32)),
+                                                                    _mm256_set1_epi8(kLutImm32)),
+                                                  _mm256_set1_epi8(kImm32)));
+        fl = _mm256_blendv_epi8(fl, _mm256_set1_epi8(char(kNeedsDecoder)), decoder);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(length + i), len);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(flags + i), fl);
+    }
+    return i;
+}
+
+#endif // SYMBOLIZE_X86_SIMD
+
+} // namespace
+
+void classify_lengths_scalar(const uint8_t* code, size_t begin, size_t end, size_t size,
+                             uint8_t* length, uint8_t* flags)
+{
+    const uint8_t* lut = opcode_lut().bytes;
+    for (size_t i = begin; i < end; ++i) {
+        const uint8_t entry = lut[code[i]];
+        if (entry & kLutDecoder || i + kLookahead > size) {
+            length[i] = 0;
+            flags[i] = kNeedsDecoder;
+            continue;
+        }
+        uint8_t len = entry & 7;
+        uint8_t fl = entry & kLutImm32 ? kImm32 : 0;
+        if (entry & kLutModrm) {
+            const uint8_t modrm = code[i + 1];
+            const uint8_t mod = modrm >> 6;
+            const uint8_t rm = modrm & 7;
+            const bool sib = mod != 3 && rm == 4;
+            const bool disp32 = mod == 2 || (mod == 0 && (rm == 5 || (sib && (code[i + 2] & 7) == 5)));
+            len += 1 + sib + (mod == 1) + (disp32 ? 4 : 0);
+            fl |= (disp32 ? kDisp32 : 0) | (sib ? kSib : 0);
+        }
+        length[i] = len;
+        flags[i] = fl;
+    }
+    static_assert(kMaxSimpleLength + 3 <= kLookahead, "lookahead must cover the longest simple encoding");
+}
+
+void classify_lengths(const uint8_t* code, size_t size, uint8_t* length, uint8_t* flags)
+{
+    size_t done = 0;
+#ifdef SYMBOLIZE_X86_SIMD
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    static const bool sse41 = __builtin_cpu_supports("sse4.1");
+    if (avx2)
+        done = classify_avx2(code, size, length, flags);
+    else if (sse41)
+        done = classify_sse41(code, size, length, flags);
+#endif
+    classify_lengths_scalar(code, done, size, size, length, flags);
+}
+
+} // namespace symbolize
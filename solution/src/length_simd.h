@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace symbolize {
+
+// Field flags produced next to every length by classify_lengths().
+enum LengthFlags : uint8_t {
+    kDisp32 = 1,        // disp32 right after ModRM (and SIB)
+    kImm32 = 2,         // imm32 in the last four bytes
+    kSib = 4,           // a SIB byte follows ModRM
+    kNeedsDecoder = 0x80,
+};
+
+// Length pass over every offset of `code`, 16 or 32 offsets per step.
+//
+// Offsets starting a prefix-free, sequential one-byte opcode whose shape does
+// not depend on ModRM.reg get their length and field flags. Offsets starting
+// prefixes, 0x0F, groups or control flow are left to the full decoder
+// (kNeedsDecoder), as is the tail where an encoding could be truncated.
+// Opcodes invalid on IA-MCU get length 0 and no flag.
+void classify_lengths(const uint8_t* code, size_t size, uint8_t* length, uint8_t* flags);
+
+// The portable implementation, also used for the tail of the vector passes.
+void classify_lengths_scalar(const uint8_t* code, size_t begin, size_t end, size_t size,
+                             uint8_t* length, uint8_t* flags);
+
+} // namespace symbolize
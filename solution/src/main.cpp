@@ -0,0 +1,118 @@
+// ./symbolize path/to/in.elf path/to/out.elf [-v] [--verify] [--signatures db] [--cache dir]
+// ./symbolize --batch manifest.txt [-v] [--verify] [--signatures db] [--cache dir]
+
+#include <unistd.h>
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "batch.h"
+#include "error.h"
+#include "function_cache.h"
+#include "pipeline.h"
+#include "result_cache.h"
+#include "signatures.h"
+
+using namespace symbolize;
+
+namespace {
+
+struct Options {
+    std::string input;
+    std::string output;
+    std::string manifest;
+    std::string signatures; // "" for the default, "-" for none
+    std::string cache;      // "" for SYMBOLIZE_CACHE, which may be unset too
+    bool verbose = false;
+    bool verify = false;
+};
+
+Options parse_args(int argc, char** argv)
+{
+    Options opts;
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-v") == 0)
+            opts.verbose = true;
+        else if (std::strcmp(argv[i], "--verify") == 0)
+            opts.verify = true;
+        else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+            opts.manifest = argv[++i];
+        else if (std::strcmp(argv[i], "--signatures") == 0 && i + 1 < argc)
+            opts.signatures = argv[++i];
+        else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            opts.cache = argv[++i];
+        else if (positional == 0 && ++positional)
+            opts.input = argv[i];
+        else if (positional == 1 && ++positional)
+            opts.output = argv[i];
+        else
+            throw Error(std::string("unexpected argument ") + argv[i]);
+    }
+    if (opts.manifest.empty() ? positional != 2 : positional != 0)
+        throw Error("usage: symbolize in.elf out.elf [-v] [--verify] [--signatures db] | symbolize --batch manifest.txt [-v] ...");
+    return opts;
+}
+
+// signatures.db next to the executable, which `make` builds.
+std::string default_signatures()
+{
+    char exe[PATH_MAX];
+    const ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (n <= 0)
+        return "";
+    std::string path(exe, size_t(n));
+    path.erase(path.rfind('/') + 1);
+    path += "signatures.db";
+    return access(path.c_str(), R_OK) == 0 ? path : "";
+}
+
+int run(const Options& opts)
+{
+    std::unique_ptr<SignatureDb> signatures;
+    const std::string db = opts.signatures.empty() ? default_signatures() : opts.signatures;
+    if (!db.empty() && db != "-")
+        signatures = std::make_unique<SignatureDb>(SignatureDb::load(db));
+
+    std::unique_ptr<ResultCache> cache;
+    std::unique_ptr<FunctionCache> functions;
+    const char* env_cache = std::getenv("SYMBOLIZE_CACHE");
+    const std::string cache_dir = opts.cache.empty() && env_cache ? env_cache : opts.cache;
+    if (!cache_dir.empty()) {
+        cache = std::make_unique<ResultCache>(cache_dir);
+        functions = std::make_unique<FunctionCache>(cache_dir);
+    }
+
+    FileOptions file_opts;
+    file_opts.verbose = opts.verbose;
+    file_opts.verify = opts.verify;
+    file_opts.signatures = signatures.get();
+    file_opts.cache = cache.get();
+    file_opts.functions = functions.get();
+    int status = 0;
+    if (!opts.manifest.empty()) {
+        status = run_batch(read_manifest(opts.manifest), worker_count(), file_opts) ? 1 : 0;
+    } else {
+        Workspace workspace;
+        symbolize_file(opts.input, opts.output, workspace, file_opts);
+    }
+    if (functions && !functions->save() && opts.verbose)
+        std::fprintf(stderr, "symbolize: cannot write the function cache to %s\n", cache_dir.c_str());
+    return status;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try {
+        return run(parse_args(argc, argv));
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "symbolize: %s\n", e.what());
+        return 1;
+    }
+}
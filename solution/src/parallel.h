@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace symbolize {
+
+// Number of worker threads: SYMBOLIZE_THREADS if set, else one per core.
+inline unsigned worker_count()
+{
+    if (const char* env = std::getenv("SYMBOLIZE_THREADS")) {
+        const int n = std::atoi(env);
+        if (n > 0)
+            return unsigned(n);
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Splits [0, size) into at most `workers` chunks of at least `min_chunk`
+// elements and runs fn(chunk_index, begin, end) on each, the first one on the
+// calling thread. Returns the number of chunks.
+template <typename Fn>
+size_t parallel_chunks(size_t size, unsigned workers, size_t min_chunk, Fn&& fn)
+{
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(workers, size / std::max<size_t>(1, min_chunk)));
+    const size_t step = (size + chunks - 1) / chunks;
+    std::vector<std::thread> threads;
+    threads.reserve(chunks - 1);
+    for (size_t c = 1; c < chunks; ++c)
+        threads.emplace_back([&fn, c, step, size] { fn(c, std::min(size, c * step), std::min(size, (c + 1) * step)); });
+    fn(size_t(0), size_t(0), std::min(size, step));
+    for (std::thread& t : threads)
+        t.join();
+    return chunks;
+}
+
+// Runs fn(worker, task) for every task in [0, count) on up to `workers`
+// threads, the first on the calling thread. Each worker starts with an equal
+// run of tasks and takes them from its front; one that runs dry steals the
+// back half of the largest run left. Tasks of very different cost (functions
+// of a few bytes next to a printf) thus keep every thread busy to the end.
+// Which worker runs a task is not deterministic; fn should write its results
+// to a slot of the task and leave merging them to the caller.
+template <typename Fn>
+void parallel_tasks(size_t count, unsigned workers, Fn&& fn)
+{
+    struct Run {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+    const size_t n = std::max<size_t>(1, std::min<size_t>(workers, count));
+    std::vector<Run> runs(n);
+    for (size_t w = 0; w < n; ++w) {
+        runs[w].begin = count * w / n;
+        runs[w].end = count * (w + 1) / n;
+    }
+
+    const auto work = [&](size_t w) {
+        for (;;) {
+            size_t task;
+            {
+                std::lock_guard<std::mutex> lock(runs[w].mutex);
+                task = runs[w].begin < runs[w].end ? runs[w].begin++ : count;
+            }
+            if (task < count) {
+                fn(w, task);
+                continue;
+            }
+            // Steal from the largest run; it may have shrunk meanwhile.
+            size_t victim = n;
+            size_t largest = 0;
+            for (size_t v = 0; v < n; ++v) {
+                std::lock_guard<std::mutex> lock(runs[v].mutex);
+                if (runs[v].end - runs[v].begin > largest) {
+                    largest = runs[v].end - runs[v].begin;
+                    victim = v;
+                }
+            }
+            if (victim == n)
+                return;
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(runs[victim].mutex);
+                end = runs[victim].end;
+                begin = runs[victim].begin + (end - runs[victim].begin) / 2;
+                runs[victim].end = begin;
+            }
+            if (begin == end)
+                continue;
+            std::lock_guard<std::mutex> lock(runs[w].mutex);
+            runs[w].begin = begin;
+            runs[w].end = end;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(n - 1);
+    for (size_t w = 1; w < n; ++w)
+        threads.emplace_back(work, w);
+    work(0);
+    for (std::thread& t : threads)
+        t.join();
+}
+
+} // namespace symbolize
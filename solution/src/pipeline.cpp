@@ -0,0 +1,158 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "cfg.h"
+#include "elf_input.h"
+#include "elf_output.h"
+#include "error.h"
+#include "flash_input.h"
+#include "heuristics.h"
+#include "relink.h"
+#include "validity.h"
+
+namespace symbolize {
+
+namespace {
+
+// An output file in memory, and how linking it compares with the input.
+struct LinkedOutput {
+    Symbolization result;
+    std::vector<uint8_t> bytes;
+    RelinkCheck check;
+};
+
+LinkedOutput link_output(const Image& image, Symbolization result)
+{
+    LinkedOutput out;
+    out.bytes = relocatable_bytes(image, result);
+    out.check = check_relink(Span<uint8_t>(out.bytes.data(), out.bytes.size()), image);
+    out.result = std::move(result);
+    return out;
+}
+
+// The likeliest hypothesis is linked first. Only when it does not give the
+// input back are the others partitioned and linked, on the worker threads,
+// and the likeliest of those that do is taken instead.
+LinkedOutput speculate(const Heuristics& heuristics, const Image& image, Symbolization likeliest,
+                       const FileOptions& opts)
+{
+    LinkedOutput best = link_output(image, std::move(likeliest));
+    if (best.check.ok)
+        return best;
+    const std::vector<Heuristics::Hypothesis> hypotheses = heuristics.hypotheses();
+    std::vector<LinkedOutput> others(hypotheses.size() - 1);
+    parallel_tasks(others.size(), opts.threads, [&](unsigned, size_t i) {
+        others[i] = link_output(image, heuristics.partition(hypotheses[i + 1]));
+    });
+    const auto it = std::find_if(others.begin(), others.end(), [](const LinkedOutput& o) { return o.check.ok; });
+    if (opts.verbose) {
+        std::fprintf(stderr, "%shypotheses: the likeliest does not relink (%s); %zu others tried, %s\n",
+                     opts.log_prefix.c_str(), best.check.mismatch.c_str(), others.size(),
+                     it == others.end() ? "none does" : "taking one that does");
+    }
+    return it == others.end() ? std::move(best) : std::move(*it);
+}
+
+// Writes the output; with --verify, one that does not link back to the input
+// fails the file.
+void write_output(const std::string& input, const std::string& output, const LinkedOutput& linked,
+                  const FileOptions& opts)
+{
+    if (opts.verbose) {
+        std::fprintf(stderr, "%srelink: %s\n", opts.log_prefix.c_str(),
+                     linked.check.ok ? "ok" : linked.check.mismatch.c_str());
+    }
+    write_relocatable(output, linked.bytes);
+    if (opts.verify && !linked.check.ok)
+        throw Error(input + ": relink differs from the input: " + linked.check.mismatch);
+}
+
+} // namespace
+
+void symbolize_file(const std::string& input, const std::string& output, Workspace& workspace,
+                    const FileOptions& opts)
+{
+    const char* prefix = opts.log_prefix.c_str();
+    workspace.scratch.reset();
+
+    Image image = load_input(input);
+    Sha256::Digest key{};
+    if (opts.cache) {
+        key = opts.cache->key(image, opts.signatures);
+        // The output is stored as written: a hit neither renders nor links.
+        LinkedOutput hit;
+        if (opts.cache->load(key, hit.bytes, hit.check)) {
+            if (opts.verbose)
+                std::fprintf(stderr, "%scache: hit %s\n", prefix, Sha256::hex(key).c_str());
+            write_output(input, output, hit, opts);
+            return;
+        }
+    }
+
+    if (image.flash_image) {
+        const FlashLayout layout = split_flash_image(image, opts.threads);
+        if (opts.verbose)
+            std::fprintf(stderr, "%sflash image: %u bytes of code, %u bytes of .data at +0x%x\n", prefix,
+                         layout.text_size, layout.data_size, layout.data_offset);
+    }
+    const Segment* text = image.text_segment();
+    if (!text)
+        throw Error(input + ": no executable PT_LOAD");
+
+    // Objects of earlier revisions are found on the bytes alone, so that
+    // every pass from the superset on can skip them.
+    ReusedObjects reused;
+    if (opts.functions)
+        reused = Heuristics::find_reused(image, opts.functions->known());
+
+    SupersetTable& table = workspace.table;
+    build_superset(*text, table, workspace.scratch, opts.threads, opts.functions ? &reused.undecoded : nullptr);
+    Bitset is_instr = compute_is_instr(table, workspace.scratch);
+    if (opts.verbose) {
+        size_t valid = 0;
+        for (size_t i = 0; i < table.size(); ++i)
+            valid += table.valid(i);
+        std::fprintf(stderr, "%ssuperset: %zu of %zu offsets decode, %zu may start an instruction\n", prefix, valid,
+                     table.size(), is_instr.count());
+    }
+
+    const Cfg cfg = build_cfg(table, is_instr, workspace.scratch, opts.functions ? &reused.skipped : nullptr);
+    if (opts.verbose)
+        std::fprintf(stderr, "%scfg: %zu blocks, %zu edges\n", prefix, cfg.blocks(), cfg.succs.size());
+
+    Heuristics heuristics(image, table, is_instr, cfg, opts.functions ? &reused : nullptr, opts.threads);
+    if (opts.functions && opts.verbose)
+        std::fprintf(stderr, "%sfunction cache: %zu functions and %zu data objects reused\n", prefix,
+                     heuristics.reused_functions(), heuristics.reused_data());
+    if (opts.verbose) {
+        size_t by_encoding[3] = {};
+        for (const auto& [addr, s] : heuristics.strings())
+            by_encoding[size_t(s.encoding)] += s.confidence >= kConfidentString;
+        std::fprintf(stderr, "%sstrings: %zu text runs; %zu ASCII, %zu UTF-8, %zu Latin-1 literals\n", prefix,
+                     heuristics.strings().size(), by_encoding[0], by_encoding[1], by_encoding[2]);
+        std::fprintf(stderr, "%sfunction scores: %zu starts\n", prefix, heuristics.scored_start.size());
+    }
+    if (opts.signatures) {
+        const size_t matched = heuristics.match_signatures(*opts.signatures);
+        if (opts.verbose)
+            std::fprintf(stderr, "%ssignatures: %zu library functions matched (at most %zu per anchor)\n", prefix,
+                         matched, opts.signatures->largest_bucket());
+    }
+    const LinkedOutput linked = speculate(heuristics, image, heuristics.run(), opts);
+    const Symbolization& result = linked.result;
+    if (opts.verbose) {
+        std::fprintf(stderr, "%sheuristics: %zu functions, %zu objects, %zu relocations (%zu rule evaluations)\n",
+                     prefix, heuristics.function.size(), result.objects.size(), result.relocations.size(),
+                     heuristics.evaluations());
+    }
+
+    if (opts.functions)
+        opts.functions->add(input, heuristics.object_signatures(result));
+    if (opts.cache && !opts.cache->store(key, linked.bytes, linked.check) && opts.verbose)
+        std::fprintf(stderr, "%scache: cannot write an entry to %s\n", prefix, opts.cache->dir().c_str());
+    write_output(input, output, linked, opts);
+}
+
+} // namespace symbolize
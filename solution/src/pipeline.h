@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+#include "arena.h"
+#include "function_cache.h"
+#include "parallel.h"
+#include "result_cache.h"
+#include "signatures.h"
+#include "superset.h"
+
+namespace symbolize {
+
+// State one thread keeps from one input to the next: the superset table
+// arrays and the scratch arena keep their capacity, so after the first few
+// inputs a worker no longer allocates for them.
+struct Workspace {
+    Arena scratch;
+    SupersetTable table;
+};
+
+struct FileOptions {
+    unsigned threads = worker_count();       // for the passes inside one input
+    bool verbose = false;                    // statistics on stderr
+    bool verify = false;                     // relink the output in memory and compare
+    std::string log_prefix;                  // put in front of every statistics line
+    const SignatureDb* signatures = nullptr; // library functions to recognise
+    const ResultCache* cache = nullptr;      // results of earlier runs
+    FunctionCache* functions = nullptr;      // functions of earlier runs
+};
+
+// Reads `input` (ELF or raw flash image), recovers its objects and writes the
+// ET_REL to `output`. Throws Error on failure.
+void symbolize_file(const std::string& input, const std::string& output, Workspace& workspace,
+                    const FileOptions& opts);
+
+} // namespace symbolize
@@ -0,0 +1,100 @@
+#include "pointer_scan.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SYMBOLIZE_X86_SIMD 1
+#endif
+
+namespace symbolize {
+
+namespace {
+
+constexpr uint32_t kSignBias = 0x80000000u;
+
+bool in_windows(uint32_t value, const std::vector<AddressWindow>& windows)
+{
+    for (const AddressWindow& w : windows)
+        if (w.contains(value))
+            return true;
+    return false;
+}
+
+#ifdef SYMBOLIZE_X86_SIMD
+
+// Offset i + k + 4j is tested in lane j of the k-th load: four loads cover
+// 4 * lanes consecutive offsets. Returns the first offset not scanned.
+__attribute__((target("avx2"))) size_t scan_avx2(const uint8_t* data, size_t size,
+                                                 const std::vector<AddressWindow>& windows, Bitset& out)
+{
+    size_t i = 0;
+    for (; i + 32 + 3 <= size; i += 32) {
+        for (unsigned k = 0; k < 4; ++k) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + k));
+            __m256i outside = _mm256_set1_epi32(-1);
+            for (const AddressWindow& w : windows) {
+                // (v - begin) <= size, unsigned, as a signed compare.
+                const __m256i rel = _mm256_sub_epi32(v, _mm256_set1_epi32(int(w.begin ^ kSignBias)));
+                const __m256i above = _mm256_cmpgt_epi32(rel, _mm256_set1_epi32(int(w.size ^ kSignBias)));
+                outside = _mm256_and_si256(outside, above);
+            }
+            unsigned hits = ~unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(outside))) & 0xFF;
+            while (hits) {
+                out.set(i + k + 4 * unsigned(__builtin_ctz(hits)));
+                hits &= hits - 1;
+            }
+        }
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) size_t scan_sse2(const uint8_t* data, size_t size,
+                                                 const std::vector<AddressWindow>& windows, Bitset& out)
+{
+    size_t i = 0;
+    for (; i + 16 + 3 <= size; i += 16) {
+        for (unsigned k = 0; k < 4; ++k) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + k));
+            __m128i outside = _mm_set1_epi32(-1);
+            for (const AddressWindow& w : windows) {
+                const __m128i rel = _mm_sub_epi32(v, _mm_set1_epi32(int(w.begin ^ kSignBias)));
+                const __m128i above = _mm_cmpgt_epi32(rel, _mm_set1_epi32(int(w.size ^ kSignBias)));
+                outside = _mm_and_si128(outside, above);
+            }
+            unsigned hits = ~unsigned(_mm_movemask_ps(_mm_castsi128_ps(outside))) & 0xF;
+            while (hits) {
+                out.set(i + k + 4 * unsigned(__builtin_ctz(hits)));
+                hits &= hits - 1;
+            }
+        }
+    }
+    return i;
+}
+
+#endif // SYMBOLIZE_X86_SIMD
+
+} // namespace
+
+Bitset find_pointer_literals(Span<uint8_t> bytes, const std::vector<AddressWindow>& windows)
+{
+    const uint8_t* data = bytes.data();
+    const size_t size = bytes.size();
+    Bitset out(size);
+    if (size < 4 || windows.empty())
+        return out;
+    size_t done = 0;
+#ifdef SYMBOLIZE_X86_SIMD
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    done = avx2 ? scan_avx2(data, size, windows, out) : scan_sse2(data, size, windows, out);
+#endif
+    for (; done + 4 <= size; ++done) {
+        uint32_t value;
+        std::memcpy(&value, data + done, 4);
+        if (in_windows(value, windows))
+            out.set(done);
+    }
+    return out;
+}
+
+} // namespace symbolize
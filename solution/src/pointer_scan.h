@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bitset.h"
+#include "span.h"
+
+namespace symbolize {
+
+// Addresses [begin, begin + size], end included: a pointer one past an object
+// (the stack top, the end of .bss) is a reference too.
+struct AddressWindow {
+    uint32_t begin = 0;
+    uint32_t size = 0;
+
+    bool contains(uint32_t value) const { return value - begin <= size; }
+};
+
+// Bit o is set when the little-endian dword at data + o, aligned or not,
+// falls inside one of `windows`. Eight (AVX2) or four (SSE2) dwords are
+// range-checked per compare, as unsigned values biased into signed ones.
+Bitset find_pointer_literals(Span<uint8_t> data, const std::vector<AddressWindow>& windows);
+
+} // namespace symbolize
@@ -0,0 +1,511 @@
+#include "relink.h"
+
+#include <elf.h>
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "error.h"
+
+namespace symbolize {
+
+namespace {
+
+constexpr char kGotSymbol[] = "_GLOBAL_OFFSET_TABLE_";
+constexpr char kEntrySymbol[] = "_start";
+// .got.plt holds the address of _DYNAMIC (0 when static) and two words for
+// the dynamic linker; _GLOBAL_OFFSET_TABLE_ is its start.
+constexpr uint32_t kGotPltSize = 12;
+
+enum Output : uint8_t { kInit, kText, kRodata, kDataRelRo, kGot, kPreserve, kData, kTdata, kTbss, kBss, kOutputs };
+
+// The output sections of picolibc.ld, in order. Those with a load image in
+// flash (AT>flash) are ALIGN_WITH_INPUT: their load address is aligned like
+// their address.
+struct OutputSection {
+    bool in_ram;
+    bool load_in_flash;
+};
+
+constexpr OutputSection kOutput[kOutputs] = {
+    {false, false}, // .init
+    {false, false}, // .text
+    {false, false}, // .rodata
+    {false, false}, // .data.rel.ro
+    {false, false}, // .got
+    {true, false},  // .preserve (NOLOAD)
+    {true, true},   // .data
+    {true, true},   // .tdata
+    {true, false},  // .tbss (NOLOAD, with .tbss_space after it)
+    {true, false},  // .bss (NOLOAD)
+};
+
+// One line of an output section: input section patterns, where a trailing
+// `*` matches any suffix, or an ALIGN(). An input section goes to the first
+// statement whose patterns match its name, and keeps its file order there.
+// The SORT_BY_NAME and SORT_BY_INIT_PRIORITY of .init and the constructor
+// lists are not modelled: the symbolizer emits neither.
+struct Statement {
+    Output output;
+    const char* patterns; // null for an ALIGN()
+    uint32_t align;
+};
+
+constexpr Statement kScript[] = {
+    {kInit, ".text.init.enter", 0},
+    {kInit, ".data.init.enter", 0},
+    {kInit, ".init .init.*", 0},
+    {kText, ".text.unlikely .text.unlikely.*", 0},
+    {kText, ".text.startup .text.startup.*", 0},
+    {kText, ".text .text.* .opd .opd.*", 0},
+    {kText, ".gnu.linkonce.t.*", 0},
+    {kText, ".fini .fini.*", 0},
+    {kText, nullptr, 8},
+    {kText, ".preinit_array", 0},
+    {kText, ".init_array.* .ctors.*", 0},
+    {kText, ".init_array .ctors", 0},
+    {kText, ".fini_array.* .dtors.*", 0},
+    {kText, ".fini_array .dtors", 0},
+    {kRodata, ".rdata", 0},
+    {kRodata, ".rodata .rodata.*", 0},
+    {kRodata, ".gnu.linkonce.r.*", 0},
+    {kRodata, ".srodata.cst16", 0},
+    {kRodata, ".srodata.cst8", 0},
+    {kRodata, ".srodata.cst4", 0},
+    {kRodata, ".srodata.cst2", 0},
+    {kRodata, ".srodata .srodata.*", 0},
+    {kDataRelRo, ".data.rel.ro .data.rel.ro.*", 0},
+    {kGot, ".got.plt", 0},
+    {kGot, ".got", 0},
+    {kPreserve, ".preserve.* .preserve", 0},
+    {kData, ".data .data.*", 0},
+    {kData, ".gnu.linkonce.d.*", 0},
+    {kData, nullptr, 8},
+    {kData, ".sdata .sdata.* .sdata2.*", 0},
+    {kData, ".gnu.linkonce.s.*", 0},
+    {kTdata, ".tdata .tdata.* .gnu.linkonce.td.*", 0},
+    {kTbss, ".tbss .tbss.* .gnu.linkonce.tb.* .tcommon", 0},
+    {kBss, ".sbss*", 0},
+    {kBss, ".gnu.linkonce.sb.*", 0},
+    {kBss, ".bss .bss.*", 0},
+    {kBss, ".gnu.linkonce.b.*", 0},
+    {kBss, nullptr, 8},
+};
+constexpr size_t kStatements = sizeof kScript / sizeof kScript[0];
+
+bool matches(const char* patterns, const std::string& name)
+{
+    while (*patterns) {
+        const char* end = std::strchr(patterns, ' ');
+        if (!end)
+            end = patterns + std::strlen(patterns);
+        const bool prefix = end[-1] == '*';
+        const size_t length = size_t(end - patterns) - prefix;
+        if (name.compare(0, length, patterns, length) == 0 && (prefix || name.size() == length))
+            return true;
+        patterns = *end ? end + 1 : end;
+    }
+    return false;
+}
+
+uint32_t align_up(uint32_t value, uint32_t align)
+{
+    return align > 1 ? (value + align - 1) & ~(align - 1) : value;
+}
+
+uint32_t read32(const uint8_t* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+void write32(uint8_t* p, uint32_t value)
+{
+    std::memcpy(p, &value, 4);
+}
+
+template <typename T>
+T read_struct(Span<uint8_t> data, size_t offset)
+{
+    if (offset > data.size() || data.size() - offset < sizeof(T))
+        throw Error("relink: truncated ELF object");
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+}
+
+// An allocated section of the object, or one the linker makes (.got.plt,
+// .got), with its contents relocated in place.
+struct InputSection {
+    std::string name;
+    uint32_t size = 0;
+    uint32_t align = 1;
+    uint32_t recovered_at = 0; // sh_addr: where the writer took it from
+    bool nobits = false;
+    std::vector<uint8_t> bytes;
+    uint32_t addr = 0;
+    uint32_t load = 0;
+};
+
+class Linker {
+public:
+    Linker(Span<uint8_t> object, const Image& image) : object_(object), image_(image) {}
+
+    RelinkCheck run();
+
+private:
+    void read_object();
+    void add_got();
+    bool place();
+    bool relocate();
+    bool compare();
+    bool symbol_address(uint32_t index, uint32_t& addr);
+    bool fail(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    Span<uint8_t> contents(const Elf32_Shdr& sh) const;
+
+    Span<uint8_t> object_;
+    const Image& image_;
+    std::vector<Elf32_Shdr> headers_;
+    std::vector<int> input_of_; // by section index, -1 if not allocated
+    std::vector<InputSection> inputs_;
+    std::vector<Elf32_Sym> symbols_;
+    std::vector<std::string> symbol_names_;
+    std::vector<const Elf32_Shdr*> rel_sections_;
+
+    uint32_t got_symbol_ = 0;           // index of _GLOBAL_OFFSET_TABLE_, 0 if none
+    std::vector<uint32_t> got_entries_; // symbols with a GOT entry, in entry order
+    std::vector<int> got_entry_of_;     // by symbol index, -1 if none
+    int got_plt_ = -1;                  // the inputs made for the GOT
+    int got_ = -1;
+    uint32_t flash_end_ = 0;            // end of what the text segment holds
+    uint32_t ram_image_ = 0;            // start and end of the RAM load image
+    uint32_t ram_image_end_ = 0;
+    std::string mismatch_;
+};
+
+bool Linker::fail(const char* format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(buf, sizeof buf, format, args);
+    va_end(args);
+    mismatch_ = buf;
+    return false;
+}
+
+Span<uint8_t> Linker::contents(const Elf32_Shdr& sh) const
+{
+    if (sh.sh_offset > object_.size() || object_.size() - sh.sh_offset < sh.sh_size)
+        throw Error("relink: section outside of the object");
+    return Span<uint8_t>(object_.data() + sh.sh_offset, sh.sh_size);
+}
+
+RelinkCheck Linker::run()
+{
+    read_object();
+    add_got();
+    RelinkCheck check;
+    check.ok = place() && relocate() && compare();
+    check.mismatch = mismatch_;
+    return check;
+}
+
+void Linker::read_object()
+{
+    const auto ehdr = read_struct<Elf32_Ehdr>(object_, 0);
+    if (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 || ehdr.e_ident[EI_CLASS] != ELFCLASS32
+        || ehdr.e_type != ET_REL || ehdr.e_shentsize != sizeof(Elf32_Shdr) || ehdr.e_shstrndx >= ehdr.e_shnum)
+        throw Error("relink: not an ELF32 relocatable object");
+    headers_.resize(ehdr.e_shnum);
+    for (size_t i = 0; i < headers_.size(); ++i)
+        headers_[i] = read_struct<Elf32_Shdr>(object_, ehdr.e_shoff + i * sizeof(Elf32_Shdr));
+
+    const Span<uint8_t> names = contents(headers_[ehdr.e_shstrndx]);
+    const auto name_at = [](Span<uint8_t> table, uint32_t offset) {
+        if (offset >= table.size())
+            throw Error("relink: name outside of its string table");
+        const char* s = reinterpret_cast<const char*>(table.data()) + offset;
+        return std::string(s, strnlen(s, table.size() - offset));
+    };
+
+    input_of_.assign(headers_.size(), -1);
+    const Elf32_Shdr* symtab = nullptr;
+    for (size_t i = 0; i < headers_.size(); ++i) {
+        const Elf32_Shdr& sh = headers_[i];
+        if (sh.sh_type == SHT_SYMTAB)
+            symtab = &sh;
+        else if (sh.sh_type == SHT_REL)
+            rel_sections_.push_back(&sh);
+        if (!(sh.sh_flags & SHF_ALLOC))
+            continue;
+        InputSection in;
+        in.name = name_at(names, sh.sh_name);
+        in.size = sh.sh_size;
+        in.align = std::max<uint32_t>(sh.sh_addralign, 1);
+        in.recovered_at = sh.sh_addr;
+        in.nobits = sh.sh_type == SHT_NOBITS;
+        if (!in.nobits) {
+            const Span<uint8_t> data = contents(sh);
+            in.bytes.assign(data.begin(), data.end());
+        }
+        input_of_[i] = int(inputs_.size());
+        inputs_.push_back(std::move(in));
+    }
+
+    if (!symtab || symtab->sh_link >= headers_.size())
+        return;
+    const Span<uint8_t> table = contents(*symtab);
+    const Span<uint8_t> strings = contents(headers_[symtab->sh_link]);
+    for (size_t off = 0; off + sizeof(Elf32_Sym) <= table.size(); off += sizeof(Elf32_Sym)) {
+        symbols_.push_back(read_struct<Elf32_Sym>(table, off));
+        symbol_names_.push_back(name_at(strings, symbols_.back().st_name));
+        if (symbols_.back().st_shndx == SHN_UNDEF && symbol_names_.back() == kGotSymbol)
+            got_symbol_ = uint32_t(symbols_.size() - 1);
+    }
+}
+
+// ld gives the local symbols their GOT entries in symbol table order, after
+// the three reserved words of .got.plt.
+void Linker::add_got()
+{
+    got_entry_of_.assign(symbols_.size(), -1);
+    std::vector<bool> wanted(symbols_.size());
+    for (const Elf32_Shdr* sh : rel_sections_) {
+        const Span<uint8_t> rels = contents(*sh);
+        for (size_t off = 0; off + sizeof(Elf32_Rel) <= rels.size(); off += sizeof(Elf32_Rel)) {
+            const auto r = read_struct<Elf32_Rel>(rels, off);
+            if (ELF32_R_TYPE(r.r_info) == R_386_GOT32 && ELF32_R_SYM(r.r_info) < symbols_.size())
+                wanted[ELF32_R_SYM(r.r_info)] = true;
+        }
+    }
+    for (uint32_t i = 0; i < symbols_.size(); ++i) {
+        if (wanted[i]) {
+            got_entry_of_[i] = int(got_entries_.size());
+            got_entries_.push_back(i);
+        }
+    }
+
+    if (!got_symbol_ && got_entries_.empty())
+        return;
+    InputSection plt;
+    plt.name = ".got.plt";
+    plt.size = kGotPltSize;
+    plt.align = 4;
+    plt.bytes.assign(kGotPltSize, 0);
+    got_plt_ = int(inputs_.size());
+    inputs_.push_back(std::move(plt));
+    if (got_entries_.empty())
+        return;
+    InputSection got;
+    got.name = ".got";
+    got.size = uint32_t(4 * got_entries_.size());
+    got.align = 4;
+    got.bytes.assign(got.size, 0);
+    got_ = int(inputs_.size());
+    inputs_.push_back(std::move(got));
+}
+
+bool Linker::place()
+{
+    std::vector<std::vector<uint32_t>> by_statement(kStatements);
+    for (uint32_t i = 0; i < inputs_.size(); ++i) {
+        size_t s = 0;
+        while (s < kStatements && !(kScript[s].patterns && matches(kScript[s].patterns, inputs_[i].name)))
+            ++s;
+        if (s == kStatements)
+            return fail("%s: no output section in the linker script", inputs_[i].name.c_str());
+        by_statement[s].push_back(i);
+    }
+
+    uint32_t flash = kFlashOrigin;
+    uint32_t ram = kRamOrigin;
+    ram_image_ = ram_image_end_ = 0;
+    for (uint8_t o = 0; o < kOutputs; ++o) {
+        // An output section without input sections is dropped.
+        uint32_t align = 1;
+        bool empty = true;
+        for (size_t s = 0; s < kStatements; ++s) {
+            if (kScript[s].output != o)
+                continue;
+            for (uint32_t i : by_statement[s]) {
+                align = std::max(align, inputs_[i].align);
+                empty = false;
+            }
+        }
+        if (empty)
+            continue;
+
+        const OutputSection& out = kOutput[o];
+        uint32_t& dot = out.in_ram ? ram : flash;
+        const uint32_t start = align_up(dot, align);
+        const uint32_t load = out.load_in_flash ? align_up(flash, align) : start;
+        uint32_t cursor = start;
+        for (size_t s = 0; s < kStatements; ++s) {
+            if (kScript[s].output != o)
+                continue;
+            if (!kScript[s].patterns)
+                cursor = align_up(cursor, kScript[s].align);
+            for (uint32_t i : by_statement[s]) {
+                InputSection& in = inputs_[i];
+                cursor = align_up(cursor, in.align);
+                in.addr = cursor;
+                in.load = load + (cursor - start);
+                cursor += in.size;
+            }
+        }
+        dot = cursor;
+        if (!out.in_ram)
+            flash_end_ = cursor;
+        if (out.load_in_flash) {
+            flash = load + (cursor - start);
+            if (!ram_image_)
+                ram_image_ = start;
+            ram_image_end_ = cursor;
+        }
+    }
+    return true;
+}
+
+bool Linker::symbol_address(uint32_t index, uint32_t& addr)
+{
+    if (index >= symbols_.size())
+        return fail("relocation against symbol %u of %zu", index, symbols_.size());
+    const Elf32_Sym& sym = symbols_[index];
+    if (sym.st_shndx == SHN_UNDEF) {
+        if (index != got_symbol_)
+            return fail("undefined symbol %s", symbol_names_[index].c_str());
+        addr = inputs_[got_plt_].addr;
+    } else if (sym.st_shndx == SHN_ABS) {
+        addr = sym.st_value;
+    } else {
+        if (sym.st_shndx >= input_of_.size() || input_of_[sym.st_shndx] < 0)
+            return fail("symbol %s in a section that is not allocated", symbol_names_[index].c_str());
+        addr = inputs_[input_of_[sym.st_shndx]].addr + sym.st_value;
+    }
+    return true;
+}
+
+bool Linker::relocate()
+{
+    const uint32_t got = got_plt_ >= 0 ? inputs_[got_plt_].addr : 0;
+    for (size_t k = 0; k < got_entries_.size(); ++k) {
+        uint32_t value;
+        if (!symbol_address(got_entries_[k], value))
+            return false;
+        write32(inputs_[got_].bytes.data() + 4 * k, value);
+    }
+
+    for (const Elf32_Shdr* sh : rel_sections_) {
+        if (sh->sh_info >= input_of_.size() || input_of_[sh->sh_info] < 0)
+            continue;
+        InputSection& target = inputs_[input_of_[sh->sh_info]];
+        const Span<uint8_t> rels = contents(*sh);
+        for (size_t off = 0; off + sizeof(Elf32_Rel) <= rels.size(); off += sizeof(Elf32_Rel)) {
+            const auto r = read_struct<Elf32_Rel>(rels, off);
+            const uint32_t type = ELF32_R_TYPE(r.r_info);
+            if (target.nobits || r.r_offset > target.size || target.size - r.r_offset < 4)
+                return fail("%s: relocation at +0x%x outside of the section", target.name.c_str(), r.r_offset);
+            uint8_t* field = target.bytes.data() + r.r_offset;
+            const uint32_t a = read32(field);
+            const uint32_t p = target.addr + r.r_offset;
+            uint32_t s;
+            if (!symbol_address(ELF32_R_SYM(r.r_info), s))
+                return false;
+            if (!got && (type == R_386_GOTPC || type == R_386_GOTOFF || type == R_386_GOT32))
+                return fail("0x%08x: GOT relocation without a GOT", p);
+            switch (type) {
+            case R_386_32: write32(field, s + a); break;
+            case R_386_PC32: write32(field, s + a - p); break;
+            case R_386_GOTOFF: write32(field, s + a - got); break;
+            case R_386_GOTPC: write32(field, got + a - p); break;
+            case R_386_GOT32: {
+                const uint32_t entry = inputs_[got_].addr + 4 * got_entry_of_[ELF32_R_SYM(r.r_info)];
+                write32(field, entry - got + a);
+                break;
+            }
+            default: return fail("0x%08x: relocation type %u is not linked", p, type);
+            }
+        }
+    }
+    return true;
+}
+
+bool Linker::compare()
+{
+    const Segment* text = image_.text_segment();
+    if (!text)
+        return fail("no code segment in the input");
+
+    for (const InputSection& in : inputs_) {
+        if (in.recovered_at && in.addr != in.recovered_at)
+            return fail("%s: linked at 0x%08x", in.name.c_str(), in.addr);
+        if (!in.size)
+            continue;
+        if (in.nobits) {
+            const Segment* seg = image_.segment_at(in.addr);
+            if (!seg || seg->end() - in.addr < in.size)
+                return fail("%s: 0x%08x-0x%08x outside of the input segments", in.name.c_str(), in.addr,
+                            in.addr + in.size);
+            continue;
+        }
+
+        const Segment* seg = nullptr;
+        for (const Segment& candidate : image_.segments)
+            if (candidate.filesz() && in.addr - candidate.vaddr < candidate.filesz()
+                && candidate.filesz() - (in.addr - candidate.vaddr) >= in.size)
+                seg = &candidate;
+        if (!seg)
+            return fail("%s: 0x%08x-0x%08x outside of the input segments", in.name.c_str(), in.addr,
+                        in.addr + in.size);
+        if (seg->paddr + (in.addr - seg->vaddr) != in.load)
+            return fail("%s: loaded at 0x%08x, the input at 0x%08x", in.name.c_str(), in.load,
+                        seg->paddr + (in.addr - seg->vaddr));
+        const uint8_t* original = seg->data.data() + (in.addr - seg->vaddr);
+        const auto diff = std::mismatch(in.bytes.begin(), in.bytes.end(), original);
+        if (diff.first != in.bytes.end())
+            return fail("0x%08x: linked 0x%02x, the input has 0x%02x", in.addr + uint32_t(diff.first - in.bytes.begin()),
+                        *diff.first, *diff.second);
+    }
+
+    // Every byte of the input segments must come from somewhere: the gaps
+    // between sections are only the padding the linker puts back.
+    if (text->vaddr + text->filesz() != flash_end_)
+        return fail("code segment ends at 0x%08x, linked up to 0x%08x", text->vaddr + text->filesz(), flash_end_);
+    bool data_segment = false;
+    for (const Segment& seg : image_.segments) {
+        if (&seg == text || !seg.filesz())
+            continue;
+        data_segment = true;
+        if (seg.vaddr != ram_image_ || seg.vaddr + seg.filesz() != ram_image_end_)
+            return fail("data segment 0x%08x-0x%08x, linked 0x%08x-0x%08x", seg.vaddr, seg.vaddr + seg.filesz(),
+                        ram_image_, ram_image_end_);
+    }
+    if (!data_segment && ram_image_ != ram_image_end_)
+        return fail("data linked at 0x%08x-0x%08x, the input has none", ram_image_, ram_image_end_);
+
+    for (size_t i = 0; i < symbols_.size(); ++i) {
+        if (ELF32_ST_BIND(symbols_[i].st_info) != STB_GLOBAL || symbol_names_[i] != kEntrySymbol)
+            continue;
+        uint32_t entry;
+        if (!symbol_address(uint32_t(i), entry))
+            return false;
+        if (entry != image_.entry)
+            return fail("%s linked at 0x%08x, the entry point is 0x%08x", kEntrySymbol, entry, image_.entry);
+    }
+    return true;
+}
+
+} // namespace
+
+RelinkCheck check_relink(Span<uint8_t> object, const Image& image)
+{
+    return Linker(object, image).run();
+}
+
+} // namespace symbolize
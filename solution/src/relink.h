@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "image.h"
+#include "span.h"
+
+namespace symbolize {
+
+struct RelinkCheck {
+    bool ok = true;
+    std::string mismatch; // the first difference found, when not ok
+};
+
+// Links `object`, an ET_REL from write_relocatable, in memory the way ld does
+// with picolibc.ld: its sections are placed by the script's input section
+// rules, .got.plt and .got are built, and R_386_32, PC32, GOTOFF, GOTPC and
+// GOT32 are applied. The placed sections must sit at the address they were
+// recovered from and hold the bytes of the input segments there; padding the
+// linker inserts is not compared. Throws Error if `object` is malformed.
+RelinkCheck check_relink(Span<uint8_t> object, const Image& image);
+
+} // namespace symbolize
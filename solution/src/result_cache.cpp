@@ -0,0 +1,151 @@
+#include "result_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "byte_io.h"
+#include "error.h"
+#include "mapped_file.h"
+
+namespace symbolize {
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'Y', 'M', 'C', 'A', 'C', 'H', 'E'};
+constexpr uint32_t kVersion = 2;
+
+bool write_all(int fd, const std::vector<uint8_t>& data)
+{
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += size_t(n);
+    }
+    return true;
+}
+
+} // namespace
+
+// The running executable: any rebuild changes the key of every entry.
+const Sha256::Digest& tool_digest()
+{
+    static const Sha256::Digest digest = [] {
+        Sha256 sha;
+        try {
+            const MappedFile exe("/proc/self/exe");
+            sha.update(exe.data(), exe.size());
+        } catch (const Error&) {
+            // Without /proc every run is its own version: nothing is reused.
+            sha.update_value(getpid());
+        }
+        return sha.finish();
+    }();
+    return digest;
+}
+
+ResultCache::ResultCache(std::string dir) : dir_(std::move(dir))
+{
+    if (mkdir(dir_.c_str(), 0777) != 0 && errno != EEXIST)
+        throw Error("cannot create cache directory " + dir_ + ": " + std::strerror(errno));
+}
+
+std::string ResultCache::path(const Sha256::Digest& key) const
+{
+    return dir_ + "/" + Sha256::hex(key);
+}
+
+Sha256::Digest ResultCache::key(const Image& image, const SignatureDb* signatures) const
+{
+    Sha256 sha;
+    sha.update(kMagic, sizeof(kMagic));
+    sha.update_value(kVersion);
+    sha.update(tool_digest().data(), tool_digest().size());
+    const Sha256::Digest no_signatures{};
+    const Sha256::Digest& db = signatures ? signatures->digest() : no_signatures;
+    sha.update(db.data(), db.size());
+
+    sha.update_value(image.entry);
+    sha.update_value(image.machine);
+    sha.update_value(uint8_t(image.flash_image));
+    sha.update_value(uint32_t(image.segments.size()));
+    for (const Segment& seg : image.segments) {
+        const uint32_t header[] = {seg.vaddr, seg.paddr, seg.filesz(), seg.memsz, seg.flags};
+        sha.update(header, sizeof(header));
+        sha.update(seg.data.data(), seg.data.size());
+    }
+    return sha.finish();
+}
+
+bool ResultCache::load(const Sha256::Digest& key, std::vector<uint8_t>& bytes, RelinkCheck& check) const
+{
+    const std::string file_path = path(key);
+    if (access(file_path.c_str(), R_OK) != 0)
+        return false;
+    try {
+        const MappedFile file(file_path);
+        ByteReader in(file.data(), file.size(), file_path);
+        char magic[sizeof(kMagic)];
+        in.bytes(magic, sizeof(magic));
+        if (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || in.u32() != kVersion)
+            return false;
+
+        // Lengths are bounded by what is left of the file (ByteReader::vector).
+        RelinkCheck entry_check;
+        entry_check.ok = in.u32() != 0;
+        const std::vector<uint8_t> mismatch = in.vector(in.u32());
+        entry_check.mismatch.assign(mismatch.begin(), mismatch.end());
+        std::vector<uint8_t> entry_bytes = in.vector(in.u32());
+        Sha256::Digest digest;
+        in.bytes(digest.data(), digest.size());
+        if (!in.at_end())
+            return false;
+        Sha256 sha;
+        sha.update(entry_bytes.data(), entry_bytes.size());
+        if (sha.finish() != digest)
+            return false;
+        bytes = std::move(entry_bytes);
+        check = std::move(entry_check);
+        return true;
+    } catch (const Error&) {
+        return false;
+    }
+}
+
+bool ResultCache::store(const Sha256::Digest& key, const std::vector<uint8_t>& bytes, const RelinkCheck& check) const
+{
+    ByteWriter out;
+    out.bytes(kMagic, sizeof(kMagic));
+    out.u32(kVersion);
+    out.u32(check.ok);
+    out.u32(uint32_t(check.mismatch.size()));
+    out.bytes(check.mismatch.data(), check.mismatch.size());
+    out.u32(uint32_t(bytes.size()));
+    out.bytes(bytes.data(), bytes.size());
+    Sha256 sha;
+    sha.update(bytes.data(), bytes.size());
+    const Sha256::Digest digest = sha.finish();
+    out.bytes(digest.data(), digest.size());
+
+    const std::string final_path = path(key);
+    std::string temp = final_path + ".XXXXXX";
+    const int fd = mkstemp(&temp[0]);
+    if (fd < 0)
+        return false;
+    const bool ok = write_all(fd, out.data());
+    if (close(fd) != 0 || !ok || rename(temp.c_str(), final_path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace symbolize
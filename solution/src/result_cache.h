@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "image.h"
+#include "relink.h"
+#include "sha256.h"
+#include "signatures.h"
+
+namespace symbolize {
+
+// SHA-256 of the running executable, or a per-process value when it cannot
+// be read.
+const Sha256::Digest& tool_digest();
+
+// Analysis results on disk, one file per input named after a SHA-256 of
+// everything the result depends on: the loaded segments and entry point,
+// the signature database and the symbolize executable itself, so a rebuilt
+// tool never sees entries of an older one. An entry is the output file, how
+// linking it compared with the input, and a SHA-256 of the output checked on
+// load. Entries are written to a temporary file and renamed, so concurrent
+// runs can share a directory.
+class ResultCache {
+public:
+    explicit ResultCache(std::string dir);
+
+    // Call before the image of a raw flash file is split.
+    Sha256::Digest key(const Image& image, const SignatureDb* signatures) const;
+
+    // False on a miss, or when the entry cannot be read or is corrupt.
+    bool load(const Sha256::Digest& key, std::vector<uint8_t>& bytes, RelinkCheck& check) const;
+    // False when the entry could not be written.
+    bool store(const Sha256::Digest& key, const std::vector<uint8_t>& bytes, const RelinkCheck& check) const;
+
+    const std::string& dir() const { return dir_; }
+
+private:
+    std::string path(const Sha256::Digest& key) const;
+
+    std::string dir_;
+};
+
+} // namespace symbolize
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace symbolize {
+
+// SHA-256 (FIPS 180-4), for content-addressed cache keys.
+class Sha256 {
+public:
+    using Digest = std::array<uint8_t, 32>;
+
+    Sha256();
+
+    void update(const void* data, size_t size);
+    template <typename T>
+    void update_value(const T& value)
+    {
+        update(&value, sizeof(value));
+    }
+    Digest finish();
+
+    static std::string hex(const Digest& digest);
+
+private:
+    void block(const uint8_t* p);
+
+    std::array<uint32_t, 8> state_;
+    std::array<uint8_t, 64> buffer_{};
+    size_t buffered_ = 0;
+    uint64_t length_ = 0;
+};
+
+} // namespace symbolize
@@ -0,0 +1,101 @@
+#include "signature_index.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "signatures.h"
+
+namespace symbolize {
+
+namespace {
+
+// Bloom filter bits per anchor: with three probes, about 3% false positives.
+constexpr size_t kBloomBitsPerKey = 16;
+
+size_t power_of_two_at_least(size_t n)
+{
+    size_t p = 1;
+    while (p < n)
+        p *= 2;
+    return p;
+}
+
+} // namespace
+
+bool SignatureIndex::has_anchor(const Signature& sig)
+{
+    size_t run = 0;
+    for (size_t i = 0; i < sig.size(); ++i) {
+        run = sig.mask[i] ? run + 1 : 0;
+        if (run == kGram)
+            return true;
+    }
+    return false;
+}
+
+void SignatureIndex::build(const std::vector<Signature>& signatures)
+{
+    // Every run of kGram fixed bytes of every signature, and in how many
+    // signatures each occurs.
+    std::vector<std::vector<Posting>> grams(signatures.size());
+    std::unordered_map<uint64_t, uint32_t> frequency;
+    std::vector<uint64_t> distinct;
+    for (size_t s = 0; s < signatures.size(); ++s) {
+        const Signature& sig = signatures[s];
+        size_t run = 0;
+        distinct.clear();
+        for (size_t i = 0; i < sig.size(); ++i) {
+            run = sig.mask[i] ? run + 1 : 0;
+            if (run < kGram)
+                continue;
+            const uint32_t anchor = uint32_t(i + 1 - kGram);
+            grams[s].push_back({hash(sig.bytes.data() + anchor), uint32_t(s), anchor});
+            distinct.push_back(grams[s].back().hash);
+        }
+        std::sort(distinct.begin(), distinct.end());
+        distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+        for (uint64_t h : distinct)
+            ++frequency[h];
+    }
+
+    // Each signature is anchored on its rarest n-gram, the first of them on a tie.
+    std::vector<Posting> postings;
+    std::unordered_map<uint64_t, size_t> bucket_sizes;
+    largest_bucket_ = 0;
+    for (const std::vector<Posting>& candidates : grams) {
+        if (candidates.empty())
+            continue;
+        const Posting* best = &candidates.front();
+        for (const Posting& p : candidates)
+            if (frequency[p.hash] < frequency[best->hash])
+                best = &p;
+        postings.push_back(*best);
+        largest_bucket_ = std::max(largest_bucket_, ++bucket_sizes[best->hash]);
+    }
+
+    const size_t bloom_bits = power_of_two_at_least(std::max<size_t>(64, postings.size() * kBloomBitsPerKey));
+    bloom_.assign(bloom_bits / 64, 0);
+    bloom_mask_ = bloom_bits - 1;
+    for (const Posting& p : postings) {
+        const uint64_t m = mix(p.hash);
+        for (unsigned k = 0; k < kBloomProbes; ++k) {
+            const uint64_t bit = (m >> (21 * k)) & bloom_mask_;
+            bloom_[bit >> 6] |= uint64_t(1) << (bit & 63);
+        }
+    }
+
+    // Counting sort of the postings by bucket.
+    const size_t buckets = power_of_two_at_least(std::max<size_t>(1, postings.size()));
+    bucket_mask_ = buckets - 1;
+    bucket_begin_.assign(buckets + 1, 0);
+    for (const Posting& p : postings)
+        ++bucket_begin_[(mix(p.hash) & bucket_mask_) + 1];
+    for (size_t b = 0; b < buckets; ++b)
+        bucket_begin_[b + 1] += bucket_begin_[b];
+    std::vector<uint32_t> fill(bucket_begin_.begin(), bucket_begin_.end() - 1);
+    postings_.resize(postings.size());
+    for (const Posting& p : postings)
+        postings_[fill[mix(p.hash) & bucket_mask_]++] = p;
+}
+
+} // namespace symbolize
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace symbolize {
+
+struct Signature;
+
+// Finds library signatures by one n-gram of fixed bytes each of them has (its
+// anchor), the one fewest other signatures share: most of them open with the
+// same prologue, which would put them all in one bucket. A Rabin-Karp hash
+// rolled over the code is checked against a Bloom filter, and only then
+// against a bucketed hash table of the anchors, so every offset of a segment
+// costs O(1) expected however many signatures there are.
+class SignatureIndex {
+public:
+    static constexpr size_t kGram = 8;
+
+    struct Posting {
+        uint64_t hash;      // of the anchor n-gram
+        uint32_t signature; // index into the signature list
+        uint32_t anchor;    // offset of the n-gram in the signature
+    };
+
+    // Whether `sig` has kGram consecutive fixed bytes, so that it can be
+    // indexed; build() picks the one of its n-grams fewest signatures share.
+    static bool has_anchor(const Signature& sig);
+
+    void build(const std::vector<Signature>& signatures);
+    bool empty() const { return postings_.empty(); }
+
+    // Most signatures sharing one anchor: the byte compares an offset whose
+    // n-gram is that anchor costs.
+    size_t largest_bucket() const { return largest_bucket_; }
+
+    // Calls fn(offset, posting) for every anchor whose hash is the one of
+    // code[offset, offset + kGram). The caller still has to compare the bytes.
+    template <typename Fn>
+    void scan(const uint8_t* code, size_t size, Fn&& fn) const
+    {
+        if (empty() || size < kGram)
+            return;
+        uint64_t h = hash(code);
+        for (size_t offset = 0;; ++offset) {
+            if (maybe_contains(h))
+                lookup(h, [&](const Posting& p) { fn(offset, p); });
+            if (offset + kGram >= size)
+                break;
+            h = (h - code[offset] * kPowerOut) * kBase + code[offset + kGram];
+        }
+    }
+
+    static uint64_t hash(const uint8_t* gram)
+    {
+        uint64_t h = 0;
+        for (size_t i = 0; i < kGram; ++i)
+            h = h * kBase + gram[i];
+        return h;
+    }
+
+private:
+    static constexpr uint64_t kBase = 0x100000001B3ull;
+    static constexpr uint64_t kPowerOut = kBase * kBase * kBase * kBase * kBase * kBase * kBase; // kBase^(kGram-1)
+    static constexpr unsigned kBloomProbes = 3;
+
+    // The polynomial hash has weak low bits; filter and buckets use a mix.
+    static uint64_t mix(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    bool maybe_contains(uint64_t h) const
+    {
+        const uint64_t m = mix(h);
+        for (unsigned k = 0; k < kBloomProbes; ++k) {
+            const uint64_t bit = (m >> (21 * k)) & bloom_mask_;
+            if (!(bloom_[bit >> 6] >> (bit & 63) & 1))
+                return false;
+        }
+        return true;
+    }
+
+    template <typename Fn>
+    void lookup(uint64_t h, Fn&& fn) const
+    {
+        const size_t bucket = mix(h) & bucket_mask_;
+        for (uint32_t i = bucket_begin_[bucket]; i < bucket_begin_[bucket + 1]; ++i)
+            if (postings_[i].hash == h)
+                fn(postings_[i]);
+    }
+
+    std::vector<uint64_t> bloom_;
+    uint64_t bloom_mask_ = 0;
+    std::vector<uint32_t> bucket_begin_; // CSR: postings of bucket b are [begin[b], begin[b + 1])
+    std::vector<Posting> postings_;
+    uint64_t bucket_mask_ = 0;
+    size_t largest_bucket_ = 0;
+};
+
+} // namespace symbolize
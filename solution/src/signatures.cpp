@@ -0,0 +1,225 @@
+#include "signatures.h"
+
+#include <elf.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+#include "byte_io.h"
+#include "error.h"
+#include "mapped_file.h"
+
+namespace symbolize {
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'Y', 'M', 'S', 'I', 'G', 'D', 'B'};
+constexpr uint32_t kVersion = 1;
+// Shorter functions (stubs, `ret`, `jmp *`) would match all over the place.
+constexpr size_t kMinFixedBytes = 12;
+
+// Archive members are only 2-aligned: every header is copied out.
+template <typename T>
+T read_struct(Span<uint8_t> data, size_t offset, const std::string& name)
+{
+    if (offset > data.size() || data.size() - offset < sizeof(T))
+        throw Error(name + ": truncated ELF object");
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+}
+
+// Bytes of the field a relocation patches.
+uint32_t field_size(uint32_t type)
+{
+    switch (type) {
+    case R_386_NONE: return 0;
+    case R_386_16: case R_386_PC16: return 2;
+    case R_386_8: case R_386_PC8: return 1;
+    default: return 4;
+    }
+}
+
+} // namespace
+
+bool Signature::matches(const uint8_t* code, size_t available) const
+{
+    if (available < bytes.size())
+        return false;
+    for (size_t i = 0; i < bytes.size(); ++i)
+        if ((code[i] & mask[i]) != bytes[i])
+            return false;
+    return true;
+}
+
+SignatureDb SignatureDb::load(const std::string& path)
+{
+    const MappedFile file(path);
+    ByteReader in(file.data(), file.size(), path);
+    char magic[sizeof(kMagic)];
+    in.bytes(magic, sizeof(magic));
+    if (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || in.u32() != kVersion)
+        throw Error(path + ": not a signature database of this version");
+
+    SignatureDb db;
+    const uint32_t count = in.u32();
+    for (uint32_t i = 0; i < count; ++i) {
+        Signature sig;
+        const std::vector<uint8_t> name = in.vector(in.u32());
+        sig.name.assign(name.begin(), name.end());
+        const uint32_t size = in.u32();
+        sig.bytes = in.vector(size);
+        sig.mask = in.vector(size);
+        const uint32_t relocs = in.u32();
+        for (uint32_t r = 0; r < relocs; ++r) {
+            SignatureReloc reloc;
+            reloc.offset = in.u32();
+            reloc.type = in.u32();
+            if (reloc.offset + field_size(reloc.type) > size)
+                throw Error(path + ": relocation outside of " + sig.name);
+            sig.relocs.push_back(reloc);
+        }
+        db.add(std::move(sig));
+    }
+    db.build_index();
+    Sha256 sha;
+    sha.update(file.data(), file.size());
+    db.digest_ = sha.finish();
+    return db;
+}
+
+void SignatureDb::save(const std::string& path) const
+{
+    ByteWriter out;
+    out.bytes(kMagic, sizeof(kMagic));
+    out.u32(kVersion);
+    out.u32(uint32_t(signatures_.size()));
+    for (const Signature& sig : signatures_) {
+        out.u32(uint32_t(sig.name.size()));
+        out.bytes(sig.name.data(), sig.name.size());
+        out.u32(uint32_t(sig.size()));
+        out.bytes(sig.bytes.data(), sig.size());
+        out.bytes(sig.mask.data(), sig.size());
+        out.u32(uint32_t(sig.relocs.size()));
+        for (const SignatureReloc& reloc : sig.relocs) {
+            out.u32(reloc.offset);
+            out.u32(reloc.type);
+        }
+    }
+
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f)
+        throw Error("cannot create " + path);
+    const bool ok = std::fwrite(out.data().data(), 1, out.data().size(), f) == out.data().size();
+    if (std::fclose(f) != 0 || !ok)
+        throw Error("cannot write " + path);
+}
+
+bool SignatureDb::add(Signature sig)
+{
+    const size_t fixed = size_t(std::count(sig.mask.begin(), sig.mask.end(), 0xFF));
+    if (fixed < kMinFixedBytes || !SignatureIndex::has_anchor(sig) || !seen_.emplace(sig.bytes, sig.mask).second)
+        return false;
+    signatures_.push_back(std::move(sig));
+    return true;
+}
+
+size_t SignatureDb::add_object(Span<uint8_t> object, const std::string& name)
+{
+    const auto ehdr = read_struct<Elf32_Ehdr>(object, 0, name);
+    if (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 || ehdr.e_ident[EI_CLASS] != ELFCLASS32
+        || ehdr.e_ident[EI_DATA] != ELFDATA2LSB)
+        throw Error(name + ": not a little-endian ELF32 object");
+    if (ehdr.e_type != ET_REL || (ehdr.e_machine != EM_386 && ehdr.e_machine != EM_IAMCU))
+        throw Error(name + ": not an i386/IA-MCU relocatable object");
+    if (ehdr.e_shentsize != sizeof(Elf32_Shdr))
+        throw Error(name + ": malformed section header table");
+
+    std::vector<Elf32_Shdr> sections(ehdr.e_shnum);
+    for (size_t i = 0; i < sections.size(); ++i)
+        sections[i] = read_struct<Elf32_Shdr>(object, ehdr.e_shoff + i * sizeof(Elf32_Shdr), name);
+    const auto contents = [&](const Elf32_Shdr& sh) {
+        if (sh.sh_type == SHT_NOBITS || sh.sh_offset > object.size() || object.size() - sh.sh_offset < sh.sh_size)
+            throw Error(name + ": section outside of the object");
+        return Span<uint8_t>(object.data() + sh.sh_offset, sh.sh_size);
+    };
+
+    // Relocations of every code section, by the section they apply to.
+    std::map<uint32_t, std::vector<SignatureReloc>> relocs;
+    const Elf32_Shdr* symtab = nullptr;
+    for (const Elf32_Shdr& sh : sections) {
+        if (sh.sh_type == SHT_SYMTAB)
+            symtab = &sh;
+        if (sh.sh_type != SHT_REL || sh.sh_info >= sections.size()
+            || !(sections[sh.sh_info].sh_flags & SHF_EXECINSTR))
+            continue;
+        const Span<uint8_t> rel = contents(sh);
+        for (size_t off = 0; off + sizeof(Elf32_Rel) <= rel.size(); off += sizeof(Elf32_Rel)) {
+            const auto r = read_struct<Elf32_Rel>(rel, off, name);
+            uint32_t type = ELF32_R_TYPE(r.r_info);
+            if (type == R_386_PLT32)
+                type = R_386_PC32;
+            relocs[sh.sh_info].push_back({r.r_offset, type});
+        }
+    }
+    if (!symtab)
+        return 0;
+
+    size_t added = 0;
+    std::set<std::pair<uint32_t, uint32_t>> done; // aliases: (section, value)
+    const Span<uint8_t> symbols = contents(*symtab);
+    const Span<uint8_t> strings = contents(sections.at(symtab->sh_link));
+    for (size_t off = 0; off + sizeof(Elf32_Sym) <= symbols.size(); off += sizeof(Elf32_Sym)) {
+        const auto sym = read_struct<Elf32_Sym>(symbols, off, name);
+        if (ELF32_ST_TYPE(sym.st_info) != STT_FUNC || !sym.st_size || sym.st_shndx == SHN_UNDEF
+            || sym.st_shndx >= sections.size() || !done.emplace(sym.st_shndx, sym.st_value).second)
+            continue;
+        const Span<uint8_t> code = contents(sections[sym.st_shndx]);
+        if (sym.st_value > code.size() || code.size() - sym.st_value < sym.st_size)
+            throw Error(name + ": function outside of its section");
+
+        Signature sig;
+        if (sym.st_name < strings.size())
+            sig.name = reinterpret_cast<const char*>(strings.data()) + sym.st_name;
+        sig.bytes.assign(code.begin() + sym.st_value, code.begin() + sym.st_value + sym.st_size);
+        sig.mask.assign(sym.st_size, 0xFF);
+        for (const SignatureReloc& r : relocs[sym.st_shndx]) {
+            const uint32_t size = field_size(r.type);
+            if (r.offset < sym.st_value || r.offset + size > sym.st_value + sym.st_size)
+                continue;
+            const uint32_t at = r.offset - sym.st_value;
+            std::fill_n(sig.mask.begin() + at, size, 0);
+            std::fill_n(sig.bytes.begin() + at, size, 0);
+            sig.relocs.push_back({at, r.type});
+        }
+        std::sort(sig.relocs.begin(), sig.relocs.end(),
+                  [](const SignatureReloc& a, const SignatureReloc& b) { return a.offset < b.offset; });
+        added += add(std::move(sig));
+    }
+    return added;
+}
+
+std::vector<SignatureDb::Hit> SignatureDb::find(Span<uint8_t> code) const
+{
+    std::vector<Hit> hits;
+    const size_t size = code.size();
+    index_.scan(code.data(), size, [&](size_t offset, const SignatureIndex::Posting& p) {
+        if (offset < p.anchor)
+            return;
+        const size_t start = offset - p.anchor;
+        const Signature& sig = signatures_[p.signature];
+        if (sig.matches(code.data() + start, size - start))
+            hits.push_back({uint32_t(start), &sig});
+    });
+    // Anchors at different offsets report starts out of order.
+    std::sort(hits.begin(), hits.end(), [](const Hit& a, const Hit& b) {
+        return a.offset != b.offset ? a.offset < b.offset : a.signature->size() > b.signature->size();
+    });
+    hits.erase(std::unique(hits.begin(), hits.end(), [](const Hit& a, const Hit& b) { return a.offset == b.offset; }),
+               hits.end());
+    return hits;
+}
+
+} // namespace symbolize
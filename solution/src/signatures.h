@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sha256.h"
+#include "signature_index.h"
+#include "span.h"
+
+namespace symbolize {
+
+// A relocation of a library function, relative to its start.
+struct SignatureReloc {
+    uint32_t offset = 0;
+    uint32_t type = 0; // R_386_*, R_386_PLT32 folded into R_386_PC32
+};
+
+// The bytes of a library function with its relocated fields wildcarded, and
+// the relocations it was linked with.
+struct Signature {
+    std::string name;
+    std::vector<uint8_t> bytes; // zero where mask is
+    std::vector<uint8_t> mask;  // 0xFF for fixed bytes, 0 inside relocated fields
+    std::vector<SignatureReloc> relocs; // sorted by offset
+
+    size_t size() const { return bytes.size(); }
+    bool matches(const uint8_t* code, size_t available) const;
+};
+
+// Signatures of picolibc/libgcc functions, built offline by `sigdb` from
+// the static libraries and loaded by symbolize to recognise linked-in
+// library code.
+class SignatureDb {
+public:
+    // Reads a database written by save(). Throws Error when it is malformed.
+    static SignatureDb load(const std::string& path);
+    void save(const std::string& path) const;
+
+    // Adds a signature for every sized STT_FUNC of an ET_REL object (EM_386
+    // or EM_IAMCU). Returns how many were new: identical functions are kept
+    // once, functions too short or too relocated to have an anchor (see
+    // SignatureIndex) not at all. Throws Error on a malformed object.
+    size_t add_object(Span<uint8_t> object, const std::string& name);
+    bool add(Signature sig);
+
+    const std::vector<Signature>& signatures() const { return signatures_; }
+    bool empty() const { return signatures_.empty(); }
+
+    // Of the file load() read; part of the result cache key.
+    const Sha256::Digest& digest() const { return digest_; }
+
+    // Indexes the signatures for find(); load() does it.
+    void build_index() { index_.build(signatures_); }
+    size_t largest_bucket() const { return index_.largest_bucket(); }
+
+    struct Hit {
+        uint32_t offset;
+        const Signature* signature;
+    };
+
+    // The longest signature matching at every offset of `code` where one
+    // does, sorted by offset.
+    std::vector<Hit> find(Span<uint8_t> code) const;
+
+private:
+    std::vector<Signature> signatures_;
+    SignatureIndex index_;
+    Sha256::Digest digest_{};
+    std::set<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>> seen_; // (bytes, mask)
+};
+
+} // namespace symbolize
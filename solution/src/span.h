@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+namespace symbolize {
+
+// A non-owning view of `size` contiguous objects (std::span is C++20).
+template <typename T>
+class Span {
+public:
+    Span() = default;
+    Span(const T* data, size_t size) : data_(data), size_(size) {}
+
+    const T* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T& operator[](size_t i) const { return data_[i]; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+
+private:
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+} // namespace symbolize
@@ -0,0 +1,214 @@
+#include "string_scan.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "bitset.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SYMBOLIZE_X86_SIMD 1
+#endif
+
+namespace symbolize {
+
+namespace {
+
+bool is_text(uint8_t b)
+{
+    return (b >= 0x20 && b < 0x7F) || b == '\t' || b == '\n' || b == '\r' || b >= 0x80;
+}
+
+#ifdef SYMBOLIZE_X86_SIMD
+
+// Printable ASCII and tab/newline/return as a byte mask. Bytes above 0x7F
+// are negative as signed bytes and fail the range compare; the caller adds
+// them from the sign bits.
+__attribute__((target("avx2"))) __m256i ascii_text_avx2(__m256i v)
+{
+    const __m256i printable = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(0x1F)),
+                                               _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7F), v));
+    const __m256i space = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')),
+                                                          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+                                          _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+    return _mm256_or_si256(printable, space);
+}
+
+// Fills whole words of `text`, 64 bytes each. Returns the first offset not
+// classified.
+__attribute__((target("avx2"))) size_t classify_avx2(const uint8_t* data, size_t size, Bitset& text)
+{
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        uint64_t t = 0;
+        for (unsigned k = 0; k < 2; ++k) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32 * k));
+            const uint32_t high = uint32_t(_mm256_movemask_epi8(v));
+            t |= uint64_t(uint32_t(_mm256_movemask_epi8(ascii_text_avx2(v))) | high) << (32 * k);
+        }
+        text.words()[i / 64] = t;
+    }
+    return i;
+}
+
+__attribute__((target("sse2"))) size_t classify_sse2(const uint8_t* data, size_t size, Bitset& text)
+{
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        uint64_t t = 0;
+        for (unsigned k = 0; k < 4; ++k) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16 * k));
+            const __m128i printable =
+                _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1F)), _mm_cmpgt_epi8(_mm_set1_epi8(0x7F), v));
+            const __m128i space = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+                _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+            const uint32_t high = uint32_t(_mm_movemask_epi8(v));
+            t |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_or_si128(printable, space))) | high) << (16 * k);
+        }
+        text.words()[i / 64] = t;
+    }
+    return i;
+}
+
+#endif // SYMBOLIZE_X86_SIMD
+
+// Length of the well-formed UTF-8 sequence at p (at most `left` bytes), or 0.
+size_t utf8_sequence(const uint8_t* p, size_t left)
+{
+    const uint8_t b = p[0];
+    size_t length;
+    uint32_t min;
+    uint32_t cp;
+    if (b < 0x80)
+        return 1;
+    if (b >= 0xC2 && b <= 0xDF) {
+        length = 2, min = 0x80, cp = b & 0x1F;
+    } else if (b >= 0xE0 && b <= 0xEF) {
+        length = 3, min = 0x800, cp = b & 0x0F;
+    } else if (b >= 0xF0 && b <= 0xF4) {
+        length = 4, min = 0x10000, cp = b & 0x07;
+    } else {
+        return 0;
+    }
+    if (length > left)
+        return 0;
+    for (size_t k = 1; k < length; ++k) {
+        if ((p[k] & 0xC0) != 0x80)
+            return 0;
+        cp = cp << 6 | (p[k] & 0x3F);
+    }
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+        return 0;
+    return length;
+}
+
+bool is_upper(uint8_t b)
+{
+    return (b >= 'A' && b <= 'Z') || (b >= 0xC0 && b <= 0xDE && b != 0xD7);
+}
+
+bool is_lower(uint8_t b)
+{
+    return (b >= 'a' && b <= 'z') || (b >= 0xDF && b != 0xF7);
+}
+
+bool is_digit(uint8_t b)
+{
+    return b >= '0' && b <= '9';
+}
+
+bool is_letter(uint8_t b)
+{
+    return is_upper(b) || is_lower(b);
+}
+
+// What may stand between two letters of a text: "don't", "e-mail", "e.g.".
+constexpr const char kInWord[] = " '-./:";
+
+} // namespace
+
+StringLiteral classify_text(const uint8_t* data, size_t size)
+{
+    // One character at a time: UTF-8 sequences first, bytes if one is not.
+    StringLiteral s;
+    s.size = uint32_t(size);
+    bool utf8 = true;
+    for (size_t i = 0; i < size;) {
+        const size_t n = utf8_sequence(data + i, size - i);
+        if (!n) {
+            utf8 = false;
+            break;
+        }
+        s.encoding = n > 1 ? StringEncoding::Utf8 : s.encoding;
+        i += n;
+    }
+    if (!utf8) {
+        s.encoding = StringEncoding::Latin1;
+        for (size_t i = 0; i < size; ++i)
+            if (data[i] >= 0x80 && data[i] < 0xA0)
+                return {};
+    }
+
+    // Words of letters keep their case (lower, Capitalised or UPPER) and
+    // do not run into digits; accented letters are the minority of a
+    // European text. Code read as text breaks these rules.
+    size_t letters = 0, accented = 0, breaks = 0;
+    uint8_t before = ' ', prev = ' ';
+    for (size_t i = 0; i < size; ++s.length) {
+        // A UTF-8 sequence counts as a lower case accented letter.
+        const size_t n = utf8 ? utf8_sequence(data + i, size - i) : 1;
+        const uint8_t c = n > 1 ? 0xE0 : data[i];
+        accented += c >= 0xC0;
+        letters += is_letter(c) || c == ' ';
+        if ((is_lower(prev) && is_upper(c)) || (is_digit(prev) && is_letter(c)) || (is_letter(prev) && is_digit(c))
+            || (is_letter(before) && is_letter(c) && !is_letter(prev) && !std::strchr(kInWord, prev)))
+            ++breaks;
+        before = prev;
+        prev = c;
+        i += n;
+    }
+    int confidence = int(std::min<size_t>(40, 10 * s.length)) + int(60 * letters / std::max<size_t>(1, s.length));
+    confidence -= 40 * int(breaks);
+    if (2 * accented > letters)
+        confidence -= 40;
+    if (s.encoding == StringEncoding::Latin1)
+        confidence -= 15;
+    s.confidence = uint8_t(std::clamp(confidence, 0, 100));
+    return s;
+}
+
+std::vector<StringLiteral> find_strings(Span<uint8_t> bytes, size_t min_length)
+{
+    const uint8_t* data = bytes.data();
+    const size_t size = bytes.size();
+    std::vector<StringLiteral> out;
+    Bitset text(size);
+    size_t done = 0;
+#ifdef SYMBOLIZE_X86_SIMD
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    done = avx2 ? classify_avx2(data, size, text) : classify_sse2(data, size, text);
+#endif
+    for (; done < size; ++done)
+        text.assign(done, is_text(data[done]));
+    // Runs end at the first byte that is not text: flip the words once so
+    // that both ends of a run are a next() away.
+    Bitset stop(size, true);
+    for (size_t w = 0; w < stop.words().size(); ++w)
+        stop.words()[w] &= ~text.words()[w];
+
+    for (size_t begin = text.next(0); begin < size; begin = text.next(begin)) {
+        const size_t end = stop.next(begin);
+        if (end < size && data[end] == 0 && end - begin >= min_length) {
+            StringLiteral s = classify_text(data + begin, end - begin);
+            if (s.length >= min_length) {
+                s.offset = uint32_t(begin);
+                out.push_back(s);
+            }
+        }
+        begin = end;
+    }
+    return out;
+}
+
+} // namespace symbolize
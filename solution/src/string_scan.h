@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "span.h"
+
+namespace symbolize {
+
+enum class StringEncoding : uint8_t { Ascii, Utf8, Latin1 };
+
+// A NUL-terminated run of text: printable ASCII (tab, newline and carriage
+// return included), well-formed UTF-8, or else Latin-1 letters and symbols
+// (0xA0 and up), like the "L\xe8t" examples/tricky_part1.S puts in code.
+struct StringLiteral {
+    uint32_t offset = 0;
+    uint32_t size = 0;        // bytes, the NUL excluded
+    uint32_t length = 0;      // characters
+    StringEncoding encoding = StringEncoding::Ascii;
+    uint8_t confidence = 0;   // 0-100: longer and more letter-like is surer
+};
+
+// Confidence from which a literal is taken as one where the bytes could be
+// read as something else (code, a pointer).
+constexpr uint8_t kConfidentString = 65;
+
+// The strings of at least `min_length` characters in `data`, each
+// starting after a byte that is not text. The bytes are classified 32 (AVX2)
+// or 16 (SSE2) at a time; only the runs that end in a NUL are then looked at
+// one character at a time.
+std::vector<StringLiteral> find_strings(Span<uint8_t> data, size_t min_length = 3);
+
+// Encoding and confidence of data[0, size), bytes that are all text and the
+// NUL after them; an empty literal if they are not UTF-8 or Latin-1 text.
+// find_strings scores its runs with it; it also scores the tail of a run.
+StringLiteral classify_text(const uint8_t* data, size_t size);
+
+} // namespace symbolize
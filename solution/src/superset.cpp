@@ -0,0 +1,107 @@
+#include "superset.h"
+
+#include <algorithm>
+
+#include "length_simd.h"
+#include "parallel.h"
+
+namespace symbolize {
+
+void SupersetTable::resize(size_t n)
+{
+    length.assign(n, 0);
+    flow.assign(n, Flow::Invalid);
+    target.assign(n, 0);
+    imm_offset.assign(n, 0);
+    disp_offset.assign(n, 0);
+}
+
+void SupersetTable::store(size_t offset, const Instruction& insn)
+{
+    length[offset] = insn.length;
+    flow[offset] = insn.flow;
+    target[offset] = insn.target;
+    imm_offset[offset] = insn.imm_offset;
+    disp_offset[offset] = insn.disp_offset;
+}
+
+namespace {
+
+// Decodes offsets [begin, end) seeing only the bytes of that chunk, so each
+// worker streams over its own cache-resident window. Offsets whose encoding
+// may continue past the chunk are appended to `seams`.
+void decode_chunk(const Segment& text, size_t begin, size_t end, SupersetTable& table, uint8_t* flags,
+                  const Bitset* undecoded, std::vector<size_t>& seams)
+{
+    const uint8_t* code = text.data.data() + begin;
+    const size_t size = end - begin;
+    flags += begin;
+    classify_lengths(code, size, table.length.data() + begin, flags);
+
+    // The vector pass settles most offsets; prefixed, two-byte, group and
+    // control-flow encodings go through the full decoder.
+    Instruction insn;
+    for (size_t i = 0; i < size; ++i) {
+        const size_t offset = begin + i;
+        const uint8_t fl = flags[i];
+        if (undecoded && undecoded->test(offset)) {
+            table.length[offset] = 0;
+        } else if (fl & kNeedsDecoder) {
+            switch (decode(code + i, size - i, text.vaddr + offset, insn)) {
+            case DecodeStatus::Ok:
+                table.store(offset, insn);
+                break;
+            case DecodeStatus::Truncated:
+                seams.push_back(offset);
+                [[fallthrough]];
+            case DecodeStatus::Invalid:
+                table.length[offset] = 0;
+                break;
+            }
+        } else if (table.length[offset]) {
+            table.flow[offset] = Flow::Sequential;
+            if (fl & kDisp32)
+                table.disp_offset[offset] = fl & kSib ? 3 : 2;
+            if (fl & kImm32)
+                table.imm_offset[offset] = table.length[offset] - 4;
+        }
+    }
+}
+
+} // namespace
+
+SupersetTable build_superset(const Segment& text, unsigned threads)
+{
+    SupersetTable table;
+    Arena scratch;
+    build_superset(text, table, scratch, threads);
+    return table;
+}
+
+void build_superset(const Segment& text, SupersetTable& table, Arena& scratch, unsigned threads,
+                    const Bitset* undecoded)
+{
+    table.base = text.vaddr;
+    table.resize(text.filesz());
+
+    // Allocated here: the arena is not shared with the workers.
+    uint8_t* flags = scratch.allocate<uint8_t>(text.filesz());
+    // parallel_chunks runs at least one chunk, even for 0 threads.
+    std::vector<std::vector<size_t>> seams(std::max(1u, threads));
+    const size_t chunks = parallel_chunks(text.filesz(), threads, kMinChunk, [&](size_t c, size_t begin, size_t end) {
+        decode_chunk(text, begin, end, table, flags, undecoded, seams[c]);
+    });
+
+    // Stitch the instructions straddling chunk boundaries: at most a few
+    // bytes before each seam, decoded again against the whole segment.
+    Instruction insn;
+    for (size_t c = 0; c < chunks; ++c) {
+        for (size_t offset : seams[c]) {
+            const uint8_t* code = text.data.data() + offset;
+            if (decode(code, text.filesz() - offset, text.vaddr + offset, insn) == DecodeStatus::Ok)
+                table.store(offset, insn);
+        }
+    }
+}
+
+} // namespace symbolize
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "bitset.h"
+#include "decoder.h"
+#include "image.h"
+#include "parallel.h"
+
+namespace symbolize {
+
+// Smallest chunk worth a thread: a few L1-sized windows.
+constexpr size_t kMinChunk = 16 * 1024;
+
+// instr[offset] from the statement: the instruction decoded at every byte of
+// a segment, kept as parallel arrays so that passes stream over one field.
+struct SupersetTable {
+    uint32_t base = 0;
+    std::vector<uint8_t> length;      // 0 when no valid instruction starts here
+    std::vector<Flow> flow;
+    std::vector<uint32_t> target;     // direct branch target, 0 if none
+    std::vector<uint8_t> imm_offset;  // offset of imm32/rel32, 0 if none
+    std::vector<uint8_t> disp_offset; // offset of disp32/moffs32, 0 if none
+
+    size_t size() const { return length.size(); }
+    bool valid(size_t offset) const { return length[offset] != 0; }
+    uint32_t address(size_t offset) const { return base + uint32_t(offset); }
+    bool contains(uint32_t addr) const { return addr - base < size(); }
+
+    void resize(size_t n);
+    void store(size_t offset, const Instruction& insn);
+};
+
+// Decodes every offset of `text`, split into per-thread chunks that are
+// stitched together afterwards.
+SupersetTable build_superset(const Segment& text, unsigned threads = worker_count());
+// The same into an existing table, whose arrays keep their capacity, with the
+// per-offset scratch taken from `scratch`. The `undecoded` offsets are left
+// invalid (see ReusedObjects).
+void build_superset(const Segment& text, SupersetTable& table, Arena& scratch, unsigned threads = worker_count(),
+                    const Bitset* undecoded = nullptr);
+
+} // namespace symbolize
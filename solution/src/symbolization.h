@@ -0,0 +1,59 @@
+#pragma once
+
+#include <elf.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace symbolize {
+
+enum class ObjectKind : uint8_t {
+    Function, // code in flash: .text.x<addr>f
+    ReadOnly, // data in flash: .rodata.x<addr>r (or .text.x<addr>t amid code)
+    Data,     // initialised RAM: .data.x<addr>d
+    Bss,      // zero-initialised RAM: .bss.x<addr>b
+};
+
+// A recovered function or variable; becomes one section and one symbol.
+struct Object {
+    uint32_t addr = 0;
+    uint32_t size = 0;
+    ObjectKind kind = ObjectKind::Function;
+
+    uint32_t end() const { return addr + size; }
+    bool contains(uint32_t a) const { return a - addr < size; }
+};
+
+// A recovered relocation. `site` is the address of the 4-byte field and
+// `target` the address it designates:
+//  - R_386_32:     the field itself,
+//  - R_386_PC32:   the end of the field plus the field (a branch destination),
+//  - R_386_GOTOFF: the GOT plus the field,
+//  - R_386_GOTPC:  the GOT,
+//  - R_386_GOT32:  the GOT entry (the GOT plus the field).
+struct Relocation {
+    uint32_t site = 0;
+    uint32_t type = R_386_NONE;
+    uint32_t target = 0;
+};
+
+// Everything the output writer needs besides the input segments.
+struct Symbolization {
+    std::vector<Object> objects;         // sorted by address, disjoint
+    std::vector<Relocation> relocations; // sorted by site, unique sites
+    uint32_t got = 0;                    // _GLOBAL_OFFSET_TABLE_, 0 if unused
+    uint32_t got_end = 0;                // end of the linker-generated .got
+
+    const Object* object_at(uint32_t addr) const
+    {
+        auto it = std::upper_bound(objects.begin(), objects.end(), addr,
+                                   [](uint32_t a, const Object& obj) { return a < obj.addr; });
+        if (it == objects.begin() || !std::prev(it)->contains(addr))
+            return nullptr;
+        return &*std::prev(it);
+    }
+};
+
+} // namespace symbolize
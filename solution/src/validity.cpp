@@ -0,0 +1,112 @@
+#include "validity.h"
+
+#include <cstdint>
+
+namespace symbolize {
+
+namespace {
+
+// Predecessors of every offset in compressed sparse row form:
+// preds[begin[v] .. begin[v + 1]) are the offsets reaching v.
+struct ReverseGraph {
+    explicit ReverseGraph(Arena& arena) : begin(ArenaAllocator<uint32_t>(arena)), preds(ArenaAllocator<uint32_t>(arena)) {}
+
+    ArenaVector<uint32_t> begin;
+    ArenaVector<uint32_t> preds;
+};
+
+// Successors of a valid offset inside the table; returns how many were stored.
+// `escapes` is set when control leaves the segment.
+int successors(const SupersetTable& table, size_t offset, uint32_t (&out)[2], bool& escapes)
+{
+    int n = 0;
+    escapes = false;
+    const Flow flow = table.flow[offset];
+    if (falls_through(flow)) {
+        const size_t next = offset + table.length[offset];
+        if (next < table.size())
+            out[n++] = uint32_t(next);
+        else
+            escapes = true;
+    }
+    if (has_direct_target(flow)) {
+        // Calls to undefined weak symbols are linked against address 0.
+        const uint32_t target = table.target[offset];
+        if (table.contains(target))
+            out[n++] = target - table.base;
+        else if (target != 0)
+            escapes = true;
+    }
+    return n;
+}
+
+ReverseGraph build_reverse_graph(const SupersetTable& table, Arena& scratch)
+{
+    const size_t size = table.size();
+    ReverseGraph graph(scratch);
+    graph.begin.assign(size + 1, 0);
+
+    uint32_t succ[2];
+    bool escapes;
+    for (size_t u = 0; u < size; ++u) {
+        if (!table.valid(u))
+            continue;
+        const int n = successors(table, u, succ, escapes);
+        for (int k = 0; k < n; ++k)
+            ++graph.begin[succ[k] + 1];
+    }
+    for (size_t v = 0; v < size; ++v)
+        graph.begin[v + 1] += graph.begin[v];
+
+    graph.preds.resize(graph.begin[size]);
+    ArenaVector<uint32_t> fill(graph.begin.begin(), graph.begin.end() - 1, ArenaAllocator<uint32_t>(scratch));
+    for (size_t u = 0; u < size; ++u) {
+        if (!table.valid(u))
+            continue;
+        const int n = successors(table, u, succ, escapes);
+        for (int k = 0; k < n; ++k)
+            graph.preds[fill[succ[k]]++] = uint32_t(u);
+    }
+    return graph;
+}
+
+} // namespace
+
+Bitset compute_is_instr(const SupersetTable& table)
+{
+    Arena scratch;
+    return compute_is_instr(table, scratch);
+}
+
+Bitset compute_is_instr(const SupersetTable& table, Arena& scratch)
+{
+    const size_t size = table.size();
+    Bitset is_instr(size);
+    ArenaVector<uint32_t> worklist{ArenaAllocator<uint32_t>(scratch)};
+    worklist.reserve(size);
+
+    uint32_t succ[2];
+    bool escapes;
+    for (size_t offset = 0; offset < size; ++offset) {
+        if (table.valid(offset) && (successors(table, offset, succ, escapes), !escapes))
+            is_instr.set(offset);
+        else
+            worklist.push_back(uint32_t(offset));
+    }
+
+    const ReverseGraph graph = build_reverse_graph(table, scratch);
+    while (!worklist.empty()) {
+        const uint32_t v = worklist.back();
+        worklist.pop_back();
+        for (uint32_t k = graph.begin[v]; k < graph.begin[v + 1]; ++k) {
+            const uint32_t u = graph.preds[k];
+            if (is_instr.test(u)) {
+                is_instr.reset(u);
+                worklist.push_back(u);
+            }
+        }
+    }
+    return is_instr;
+}
+
+} // namespace symbolize
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "arena.h"
+#include "bitset.h"
+#include "superset.h"
+
+namespace symbolize {
+
+// is_instr[offset] from the statement. An offset cannot start an instruction if
+//  - its bytes are not a valid lakemont encoding,
+//  - it falls through to an offset that cannot (or off the segment),
+//  - it jumps or calls outside the segment (0 is an undefined weak symbol),
+//  - it jumps or calls to an offset that cannot.
+// The rules are propagated backwards from the invalid offsets over a reverse
+// fall-through/branch graph, so every offset is visited a constant number of times.
+Bitset compute_is_instr(const SupersetTable& table);
+// The same with the graph and worklist taken from `scratch`.
+Bitset compute_is_instr(const SupersetTable& table, Arena& scratch);
+
+} // namespace symbolize
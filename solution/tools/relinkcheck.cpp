@@ -0,0 +1,174 @@
+// ./relinkcheck in.elf out.o
+//
+// Checks check_relink both ways on an output of symbolize: out.o must link
+// back to in.elf, and two corrupted copies of it must not, each with the
+// mismatch that pins the corruption down:
+//   - a section recovered at the wrong address: "<section>: linked at <addr>";
+//   - an R_386_32 relocation turned into PC32 (or back): the field's first
+//     byte differs by that of its address, "<addr>: linked <b>, the input
+//     has <b>".
+// Prints one line per case, "skipped" for a corruption the object leaves no
+// room for; exits with 1 if any of them differs.
+
+#include <elf.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "elf_input.h"
+#include "error.h"
+#include "mapped_file.h"
+#include "relink.h"
+
+using namespace symbolize;
+
+namespace {
+
+template <typename T>
+T load(const std::vector<uint8_t>& bytes, size_t offset)
+{
+    if (offset > bytes.size() || bytes.size() - offset < sizeof(T))
+        throw Error("relinkcheck: truncated object");
+    T value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+void store(std::vector<uint8_t>& bytes, size_t offset, const T& value)
+{
+    std::memcpy(bytes.data() + offset, &value, sizeof(T));
+}
+
+std::string format(const char* format, uint32_t a, uint32_t b = 0, uint32_t c = 0)
+{
+    char buf[128];
+    std::snprintf(buf, sizeof buf, format, a, b, c);
+    return buf;
+}
+
+struct Object {
+    std::vector<uint8_t> bytes;
+    std::vector<Elf32_Shdr> headers;
+    std::vector<size_t> header_offsets;
+
+    std::string name(const Elf32_Shdr& sh) const
+    {
+        const Elf32_Shdr& names = headers.at(load<Elf32_Ehdr>(bytes, 0).e_shstrndx);
+        const size_t at = size_t(names.sh_offset) + sh.sh_name;
+        if (at >= bytes.size())
+            throw Error("relinkcheck: section name outside of the object");
+        return std::string(reinterpret_cast<const char*>(bytes.data() + at),
+                           strnlen(reinterpret_cast<const char*>(bytes.data() + at), bytes.size() - at));
+    }
+};
+
+Object read_object(const MappedFile& file)
+{
+    Object obj;
+    obj.bytes.assign(file.data(), file.data() + file.size());
+    const auto ehdr = load<Elf32_Ehdr>(obj.bytes, 0);
+    if (std::memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 || ehdr.e_type != ET_REL || ehdr.e_shstrndx >= ehdr.e_shnum)
+        throw Error("relinkcheck: not an ELF32 relocatable object");
+    for (size_t i = 0; i < ehdr.e_shnum; ++i) {
+        obj.header_offsets.push_back(ehdr.e_shoff + i * sizeof(Elf32_Shdr));
+        obj.headers.push_back(load<Elf32_Shdr>(obj.bytes, obj.header_offsets.back()));
+    }
+    return obj;
+}
+
+// The first allocated section with contents, moved by 4: it is still linked
+// where the script puts it.
+bool move_section(Object& obj, std::string& expected)
+{
+    for (size_t i = 0; i < obj.headers.size(); ++i) {
+        Elf32_Shdr sh = obj.headers[i];
+        if (!(sh.sh_flags & SHF_ALLOC) || !sh.sh_addr || !sh.sh_size)
+            continue;
+        expected = obj.name(sh) + format(": linked at 0x%08x", sh.sh_addr);
+        sh.sh_addr += 4;
+        store(obj.bytes, obj.header_offsets[i], sh);
+        return true;
+    }
+    return false;
+}
+
+// The first R_386_32 or PC32 relocation of a PROGBITS section whose field
+// does not start at a multiple of 256, the other type.
+bool swap_relocation(Object& obj, const Image& image, std::string& expected)
+{
+    for (const Elf32_Shdr& rel : obj.headers) {
+        if (rel.sh_type != SHT_REL || rel.sh_info >= obj.headers.size())
+            continue;
+        const Elf32_Shdr& target = obj.headers[rel.sh_info];
+        if (target.sh_type != SHT_PROGBITS || !(target.sh_flags & SHF_ALLOC))
+            continue;
+        for (size_t off = rel.sh_offset; off + sizeof(Elf32_Rel) <= size_t(rel.sh_offset) + rel.sh_size;
+             off += sizeof(Elf32_Rel)) {
+            Elf32_Rel r = load<Elf32_Rel>(obj.bytes, off);
+            const uint32_t type = ELF32_R_TYPE(r.r_info);
+            const uint32_t p = target.sh_addr + r.r_offset;
+            const Segment* seg = image.segment_at(p);
+            if ((type != R_386_32 && type != R_386_PC32) || p % 256 == 0 || !seg || p - seg->vaddr >= seg->filesz())
+                continue;
+            const uint8_t input = seg->data[p - seg->vaddr];
+            const uint8_t linked = uint8_t(type == R_386_32 ? input - p : input + p);
+            expected = format("0x%08x: linked 0x%02x, the input has 0x%02x", p, linked, input);
+            r.r_info = ELF32_R_INFO(ELF32_R_SYM(r.r_info), type == R_386_32 ? R_386_PC32 : R_386_32);
+            store(obj.bytes, off, r);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Prints the outcome of one case; false if it is not `expected` ("ok" for a
+// check that passes).
+bool report(const char* what, const RelinkCheck& check, const std::string& expected)
+{
+    const std::string got = check.ok ? "ok" : check.mismatch;
+    std::printf("%s: %s\n", what, got.c_str());
+    if (got == expected)
+        return true;
+    std::printf("%s: expected %s\n", what, expected.c_str());
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: relinkcheck in.elf out.o\n");
+        return 1;
+    }
+    try {
+        const Image image = load_input(argv[1]);
+        if (image.flash_image)
+            throw Error("relinkcheck: flash images need the layout symbolize picked");
+        const MappedFile file(argv[2]);
+        const Object object = read_object(file);
+        const auto check = [&](const Object& obj) {
+            return check_relink(Span<uint8_t>(obj.bytes.data(), obj.bytes.size()), image);
+        };
+
+        bool ok = report("relink", check(object), "ok");
+        Object moved = object;
+        std::string expected;
+        if (move_section(moved, expected))
+            ok &= report("wrong section address", check(moved), expected);
+        else
+            std::printf("wrong section address: skipped, no allocated section with contents\n");
+        Object swapped = object;
+        if (swap_relocation(swapped, image, expected))
+            ok &= report("wrong relocation type", check(swapped), expected);
+        else
+            std::printf("wrong relocation type: skipped, no R_386_32 or PC32 field qualifies\n");
+        return ok ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "relinkcheck: %s\n", e.what());
+        return 1;
+    }
+}
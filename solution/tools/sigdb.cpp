@@ -0,0 +1,68 @@
+// ./sigdb out.db lib.a|obj.o...
+//
+// Builds the signature database symbolize uses to recognise library code.
+// Archives that do not exist are skipped with a warning, so the build works
+// with whatever part of picolibc/libgcc is installed.
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "archive.h"
+#include "error.h"
+#include "mapped_file.h"
+#include "signatures.h"
+
+using namespace symbolize;
+
+namespace {
+
+bool is_archive(const MappedFile& file)
+{
+    return file.size() >= 8 && std::memcmp(file.data(), "!<arch>\n", 8) == 0;
+}
+
+void add_input(SignatureDb& db, const std::string& path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        std::fprintf(stderr, "sigdb: %s: missing, skipped\n", path.c_str());
+        return;
+    }
+    const MappedFile file(path);
+    size_t added = 0;
+    size_t objects = 0;
+    if (is_archive(file)) {
+        for (const ArchiveMember& member : read_archive(file, path)) {
+            added += db.add_object(member.data, path + "(" + member.name + ")");
+            ++objects;
+        }
+    } else {
+        added += db.add_object({file.data(), file.size()}, path);
+        ++objects;
+    }
+    std::fprintf(stderr, "sigdb: %s: %zu objects, %zu new signatures\n", path.c_str(), objects, added);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: sigdb out.db lib.a|obj.o...\n");
+        return 1;
+    }
+    try {
+        SignatureDb db;
+        for (int i = 2; i < argc; ++i)
+            add_input(db, argv[i]);
+        db.save(argv[1]);
+        std::fprintf(stderr, "sigdb: %zu signatures in %s\n", db.signatures().size(), argv[1]);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "sigdb: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
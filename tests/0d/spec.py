@@ -0,0 +1,26 @@
+# Using Python files for now, it should be parsed from YAML
+
+# examples/tj.c with tj_part.S (`make BUILD=release examples/tj.elf`):
+# examples/tricky.c (without FULL_TEST_VERSION) and examples/tricky_part1.S,
+# with div, abs, itoa, utoa and puts defined next to main instead of taken
+# from picolibc: func_jumptable, the Latin-1 literal, the tail call through
+# french_tail_callback and the stubs jumping back into libc.
+PRECOMPILED_ELF_FILE = 'tricky.elf'
+
+SPEC = TestSpec(
+    link_mode='static',
+    links_picolibc=False,
+    pic='unrestricted',
+    extra_cflags=(),
+    unmodified_behavior=RunSpec(exit_code=47, expected_stdout='tricky.stdout'),
+    replacement=ReplacementSpec(
+        RunSpec(
+            exit_code=123,
+            expected_stdout='tricky.stdout'
+        ),
+        replacements=[SectionReplacement(
+            bin_file='/replacements/exit123.bin',
+            symbol_name='_exit',
+        )],
+    )
+)
@@ -0,0 +1,23 @@
+# Using Python files for now, it should be parsed from YAML
+
+# examples/swt.c built with -fno-pic: two switches compiled to absolute jump
+# tables in .rodata, one of them with a hole (case 7) and a fall-through.
+PRECOMPILED_ELF_FILE = 'swt.elf'
+
+SPEC = TestSpec(
+    link_mode='static',
+    links_picolibc=False,
+    pic='none',
+    extra_cflags=(),
+    unmodified_behavior=RunSpec(exit_code=0, expected_stdout='swt.stdout'),
+    replacement=ReplacementSpec(
+        RunSpec(
+            exit_code=123,
+            expected_stdout='swt.stdout'
+        ),
+        replacements=[SectionReplacement(
+            bin_file='/replacements/exit123.bin',
+            symbol_name='_exit',
+        )],
+    )
+)
@@ -0,0 +1,24 @@
+# Using Python files for now, it should be parsed from YAML
+
+# examples/min_got_harder.S: the GOT set up in %ecx through its own thunk,
+# a GOT32 entry read with lea, GOTOFF fields with an index register and with
+# an addend folded into the GOT register.
+PRECOMPILED_ELF_FILE = 'min_got_harder.elf'
+
+SPEC = TestSpec(
+    link_mode='static',
+    links_picolibc=False,
+    pic='unrestricted',
+    extra_cflags=(),
+    unmodified_behavior=RunSpec(exit_code=114),
+    replacement=ReplacementSpec(
+        RunSpec(
+            exit_code=123,
+            expected_stdout=None
+        ),
+        replacements=[SectionReplacement(
+            bin_file='/replacements/exit123.bin',
+            symbol_name='_exit',
+        )],
+    )
+)
@@ -0,0 +1,24 @@
+# Using Python files for now, it should be parsed from YAML
+
+# examples/trk.c with trk_part.S: main passes a function pointer on to
+# french_tail_callback, which tail-calls it through %edx with a Latin-1
+# literal ("L\xe8t") right behind the jmp.
+PRECOMPILED_ELF_FILE = 'trk.elf'
+
+SPEC = TestSpec(
+    link_mode='static',
+    links_picolibc=False,
+    pic='unrestricted',
+    extra_cflags=(),
+    unmodified_behavior=RunSpec(exit_code=0, expected_stdout='trk.stdout'),
+    replacement=ReplacementSpec(
+        RunSpec(
+            exit_code=123,
+            expected_stdout='trk.stdout'
+        ),
+        replacements=[SectionReplacement(
+            bin_file='/replacements/exit123.bin',
+            symbol_name='_exit',
+        )],
+    )
+)
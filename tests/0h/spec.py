@@ -0,0 +1,24 @@
+# Using Python files for now, it should be parsed from YAML
+
+# examples/mvz.c with mvz_part.S: high_byte, only reached through a function
+# pointer, starts with movzbl %dh,%eax. It reads the argument in %edx, so it
+# must still be taken as a function start (listed in `functions`).
+PRECOMPILED_ELF_FILE = 'mvz.elf'
+
+SPEC = TestSpec(
+    link_mode='static',
+    links_picolibc=False,
+    pic='unrestricted',
+    extra_cflags=(),
+    unmodified_behavior=RunSpec(exit_code=47),
+    replacement=ReplacementSpec(
+        RunSpec(
+            exit_code=123,
+            expected_stdout=None
+        ),
+        replacements=[SectionReplacement(
+            bin_file='/replacements/exit123.bin',
+            symbol_name='_exit',
+        )],
+    )
+)